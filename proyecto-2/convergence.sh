@@ -0,0 +1,31 @@
+#!/bin/bash
+
+# Compara la eficiencia de los 3 métodos de muestreo de direcciones:
+# error contra una referencia de muchas muestras en función del tiempo y del
+# número de rayos. Uso: ./convergence.sh [segundos] [resolución] [salida.csv] [escena.txt]
+
+cd "$(dirname "$0")"
+
+budget=${1:-60}
+size=${2:-256x192}
+output=${3:-convergence.csv}
+scene=${4:-}
+refspp=8192
+# La referencia depende de la escena, la resolución y ref-spp; rt además
+# revisa esos datos en el comentario del PFM antes de reutilizarla
+reference=reference-$(basename "${scene:-cornell}" .txt)-${size}-${refspp}.pfm
+sceneArgs=()
+[ -n "$scene" ] && sceneArgs=(--scene "$scene")
+
+make -s rt || exit 1
+
+# La referencia se renderiza una sola vez y se reutiliza en las siguientes corridas
+header=1
+for method in uniform-sphere uniform-hemisphere cosine-hemisphere; do
+    echo "Midiendo ${method}..." >&2
+    ./rt --converge --sampling "$method" --size "$size" "${sceneArgs[@]}" --reference "$reference" \
+         --ref-spp "$refspp" --interval 1 --time "$budget" | tail -n +$((header ? 1 : 2))
+    header=0
+done > "$output"
+
+echo "Generated: $output"
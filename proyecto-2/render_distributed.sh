@@ -0,0 +1,32 @@
+#!/bin/bash
+
+# Renderiza la escena con un coordinador y varios trabajadores locales.
+# Uso: ./render_distributed.sh [trabajadores] [spp] [salida.ppm]
+# Cada trabajador es un proceso ./rt independiente. El socket es un socket
+# Unix, así que solo lo alcanzan procesos del mismo equipo: sirve para usar
+# varios procesos locales o probar altas y bajas, no para repartir entre nodos.
+
+cd "$(dirname "$0")"
+
+workers=${1:-4}
+spp=${2:-512}
+output=${3:-image.ppm}
+socket=/tmp/rt-$$.sock
+
+make -s rt || exit 1
+
+./rt --coordinator "$socket" --spp "$spp" -o "$output" &
+coordinator=$!
+
+# Esperar a que el coordinador cree el socket
+while [ ! -S "$socket" ]; do sleep 0.1; done
+
+for i in $(seq 1 "$workers"); do
+    OMP_NUM_THREADS=1 ./rt --worker "$socket" &
+done
+
+wait $coordinator
+status=$?
+wait
+echo "Generated: $output"
+exit $status
@@ -5,6 +5,28 @@
 #include <stdio.h>  
 #include <omp.h>
 #include <random>
+#include <vector>
+#include <algorithm>
+#include <deque>
+#include <list>
+#include <map>
+#include <memory>
+#include <new>
+#include <string>
+#include <utility>
+#include <string.h>
+#include <stdarg.h>
+#include <errno.h>
+#include <signal.h>
+#include <poll.h>
+#include <unistd.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <sched.h>
+#include <stdint.h>
 
 // Thread-safe random number generation for OpenMP
 thread_local std::mt19937 rng(std::random_device{}());
@@ -21,7 +43,7 @@ public:
 	double x, y, z; // coordenadas x,y,z 
   
 	// Constructor del vector, parametros por default en cero
-	Vector(double x_= 0, double y_= 0, double z_= 0){ x=x_; y=y_; z=z_; }
+	constexpr Vector(double x_= 0, double y_= 0, double z_= 0) : x(x_), y(y_), z(z_) {}
   
 	// operador para suma y resta de vectores
 	Vector operator+(const Vector &b) const { return Vector(x + b.x, y + b.y, z + b.z); }
@@ -59,7 +81,7 @@ public:
 	Point p;	// posicion
 	Color c;	// color  
 
-	Sphere(double r_, Point p_, Color c_): r(r_), p(p_), c(c_) {}
+	constexpr Sphere(double r_, Point p_, Color c_): r(r_), p(p_), c(c_) {}
   
 	// determina si el rayo intersecta a esta esfera
 	// Implementa la intersección rayo-esfera usando la ecuación cuadrática
@@ -102,7 +124,8 @@ public:
 };
 
 // Cornell Box scene configuration para Proyecto 2
-Sphere spheres[] = {
+// Es constexpr: la escena compilada (bakedIntersect) la lee directamente
+constexpr Sphere spheres[] = {
 	// Geometría de la escena Cornell Box
 	Sphere(1e5,  Point(-1e5 - 49, 0, 0),     Color(.75, .25, .25)), // pared izq (roja)
 	Sphere(1e5,  Point(1e5 + 49, 0, 0),      Color(.25, .25, .75)), // pared der (azul)
@@ -118,7 +141,20 @@ Sphere spheres[] = {
 const int LIGHT_SPHERE_ID = 7;  // Índice de la esfera fuente de luz
 
 // Emisión de la fuente luminosa
-const Vector LIGHT_EMISSION = Vector(10, 10, 10);
+constexpr Vector LIGHT_EMISSION = Vector(10, 10, 10);
+
+// Escena activa: esferas, índice de la esfera fuente y su emisión. Por
+// defecto es la Cornell Box de spheres[]; el servicio de render la cambia
+// entre trabajos, nunca a mitad de una franja.
+struct Scene {
+	std::vector<Sphere> spheres;
+	int light;
+	Vector emission;
+};
+
+Scene cornellBox = { std::vector<Sphere>(spheres, spheres + sizeof(spheres) / sizeof(Sphere)),
+                     LIGHT_SPHERE_ID, LIGHT_EMISSION };
+const Scene *scene = &cornellBox;
 
 // limita el valor de x a [0,1]
 inline double clamp(const double x) { 
@@ -145,12 +181,28 @@ enum SamplingMethod {
 const SamplingMethod SAMPLING_METHOD = COSINE_HEMISPHERE; // Change this to test different methods
 const int SAMPLES_PER_PIXEL = 2048;  // Change this to 32, 512, or 2048
 
+// Método usado en tiempo de ejecución; --sampling lo cambia sin recompilar
+SamplingMethod samplingMethod = SAMPLING_METHOD;
+
+// Rayos trazados por cada hilo (para medir eficiencia por rayo)
+thread_local unsigned long long rayCount = 0;
+
+// Configuración del mapa de fotones (pre-pase desde el emisor, con --photons;
+// --photon-passes N > 1 activa el modo progresivo)
+const int PHOTONS_PER_PASS = 200000;     // fotones emitidos en cada pase
+const int PHOTON_KNN = 64;               // vecinos usados en la estimación de densidad (un pase)
+const double PHOTON_RADIUS = 2.0;        // radio máximo del k-NN; radio inicial en modo progresivo
+const double PHOTON_ALPHA = 0.7;         // factor de reducción del radio entre pases
+const int PHOTON_MAX_BOUNCES = 5;        // mismo límite de rebotes que shade()
+
 // calcular la intersección del rayo r con todas las esferas
 // regresar true si hubo una intersección, falso de otro modo
 // almacenar en t la distancia sobre el rayo en que sucede la interseccion
-// almacenar en id el indice de spheres[] de la esfera cuya interseccion es mas cercana
+// almacenar en id el indice de la esfera de la escena activa cuya interseccion es mas cercana
 inline bool intersect(const Ray &r, double &t, int &id) {
-	double n = sizeof(spheres) / sizeof(Sphere);  // número de esferas en la escena
+	rayCount++;
+	const Sphere *spheres = scene->spheres.data();
+	int n = scene->spheres.size();  // número de esferas en la escena
 	double d;      // distancia temporal para cada intersección
 	double inf = 1e20;  // valor "infinito" para inicializar distancia mínima
 	t = inf;       // inicializar con distancia infinita
@@ -170,6 +222,60 @@ inline bool intersect(const Ray &r, double &t, int &id) {
 	return t < inf;
 }
 
+// ---------------------------------------------------------------------------
+// Escena compilada: la Cornell Box como constexpr
+// ---------------------------------------------------------------------------
+
+// La escena compilada es spheres[] mismo. Con los radios y posiciones
+// conocidos en tiempo de compilación, bakedIntersect queda desenrollado esfera
+// por esfera y el compilador pliega las constantes: r² de cada esfera y las
+// restas con las componentes en cero del centro de las paredes desaparecen.
+// La fuente de luz y su emisión también son constantes.
+constexpr int BAKED_SIZE = sizeof(spheres) / sizeof(Sphere);
+constexpr int BAKED_LIGHT = LIGHT_SPHERE_ID;
+static_assert(BAKED_LIGHT >= 0 && BAKED_LIGHT < BAKED_SIZE, "LIGHT_SPHERE_ID fuera de spheres[]");
+
+// Intersección con la esfera I. Repite las operaciones de Sphere::intersect
+// en el mismo orden para que el resultado sea idéntico bit a bit; a = d·d y
+// 2a se calculan una sola vez por rayo.
+template <int I>
+inline void bakedIntersectSphere(const Ray &ray, double a, double twoA, double &t, int &id) {
+	constexpr Sphere s = spheres[I];
+	constexpr double r2 = s.r * s.r;
+
+	Vector oc = Vector(ray.o.x - s.p.x, ray.o.y - s.p.y, ray.o.z - s.p.z);
+	double b = 2.0 * oc.dot(ray.d);
+	double c = oc.dot(oc) - r2;
+	double discriminant = b * b - 4 * a * c;
+	if (discriminant < 0)
+		return;
+
+	double sqrt_discriminant = sqrt(discriminant);
+	double t1 = (-b - sqrt_discriminant) / twoA;
+	double t2 = (-b + sqrt_discriminant) / twoA;
+	double d = t1 > 1e-4 ? t1 : (t2 > 1e-4 ? t2 : 0.0);
+
+	if (d > 0 && d < t) {
+		t = d;
+		id = I;
+	}
+}
+
+template <int... I>
+inline bool bakedIntersectAll(const Ray &r, double &t, int &id, std::integer_sequence<int, I...>) {
+	double a = r.d.dot(r.d);
+	double twoA = 2.0 * a;
+	t = 1e20;
+	(bakedIntersectSphere<I>(r, a, twoA, t, id), ...);
+	return t < 1e20;
+}
+
+// Igual que intersect() pero sobre la escena compilada
+inline bool bakedIntersect(const Ray &r, double &t, int &id) {
+	rayCount++;
+	return bakedIntersectAll(r, t, id, std::make_integer_sequence<int, BAKED_SIZE>());
+}
+
 // Genera un punto uniformemente distribuido en una esfera unitaria
 Vector uniform_sphere_sample() {
     double u1 = uniform_random();
@@ -231,7 +337,9 @@ double get_pdf(const SamplingMethod method, const Vector& sample_dir, const Vect
 }
 
 // Calcula el valor de color para el rayo dado usando Monte Carlo ray tracing
-Color shade(const Ray &r, int depth = 0) {
+// Baked = true usa la escena compilada (bakedIntersect, fuente conocida)
+template <bool Baked>
+Color shadeScene(const Ray &r, int depth = 0) {
 	double t;
 	int id = 0;
 	
@@ -239,10 +347,10 @@ Color shade(const Ray &r, int depth = 0) {
 	if (depth > 5) return Color();
 	
 	// Determinar que esfera (id) y a que distancia (t) el rayo intersecta
-	if (!intersect(r, t, id))
+	if (!(Baked ? bakedIntersect(r, t, id) : intersect(r, t, id)))
 		return Color();	// El rayo no intersectó objeto, retornar negro
   
-	const Sphere &obj = spheres[id];
+	const Sphere &obj = Baked ? spheres[id] : scene->spheres[id];
 	
 	// Determinar coordenadas del punto de intersección
 	Point x = r.o + r.d * t;
@@ -257,8 +365,8 @@ Color shade(const Ray &r, int depth = 0) {
 	Color result = Color();
 	
 	// Si es la fuente de luz, agregar emisión
-	if (id == LIGHT_SPHERE_ID) {
-		result = result + LIGHT_EMISSION.mult(obj.c);
+	if (Baked ? id == BAKED_LIGHT : id == scene->light) {
+		result = result + (Baked ? LIGHT_EMISSION : scene->emission).mult(obj.c);
 		return result; // Las fuentes de luz no reflejan otras luces
 	}
 	
@@ -275,7 +383,7 @@ Color shade(const Ray &r, int depth = 0) {
 			double pdf;
 			
 			// Generar dirección de muestra según el método configurado
-			switch (SAMPLING_METHOD) {
+			switch (samplingMethod) {
 				case UNIFORM_SPHERE:
 					sample_dir = uniform_sphere_sample();
 					pdf = get_pdf(UNIFORM_SPHERE, sample_dir, normal);
@@ -300,7 +408,7 @@ Color shade(const Ray &r, int depth = 0) {
 				Ray secondary_ray = Ray(x + normal * 1e-4, sample_dir);
 				
 				// Obtener color de iluminación indirecta recursivamente
-				Color Li = shade(secondary_ray, depth + 1);
+				Color Li = shadeScene<Baked>(secondary_ray, depth + 1);
 				
 				// BRDF Lambertiana: fr = albedo / π
 				Vector brdf = obj.c * (1.0 / M_PI);
@@ -325,65 +433,2237 @@ Color shade(const Ray &r, int depth = 0) {
 	return result;
 }
 
+// Color del rayo sobre la escena activa
+inline Color shade(const Ray &r, int depth = 0) { return shadeScene<false>(r, depth); }
 
-int main(int argc, char *argv[]) {
-	int w = 1024, h = 768; // image resolution
-  
-	// fija la posicion de la camara y la dirección en que mira
-	Ray camera( Point(0, 11.2, 214), Vector(0, -0.042612, -1).normalize() );
+// Color del rayo sobre la Cornell Box compilada
+inline Color bakedShade(const Ray &r, int depth = 0) { return shadeScene<true>(r, depth); }
 
-	// parametros de la camara
-	Vector cx = Vector( w * 0.5095 / h, 0., 0.); 
-	Vector cy = (cx % camera.d).normalize() * 0.5095;
-  
-	// auxiliar para valor de pixel y matriz para almacenar la imagen
-	Color *pixelColors = new Color[w * h];
 
-	// usar openmp para paralelizar el ciclo: cada hilo computara un renglon (ciclo interior)
-	#pragma omp parallel for schedule(dynamic, 1)
-	for(int y = 0; y < h; y++) 
-	{ 
-		// recorre todos los pixeles de la imagen
-		fprintf(stderr,"\r%5.2f%%",100.*y/(h-1));
-		for(int x = 0; x < w; x++ ) {
-			int idx = (h - y - 1) * w + x; // index en 1D para una imagen 2D x,y son invertidos
-			Color pixelValue = Color(); // pixelValue en negro por ahora
-			
-			// Monte Carlo sampling: usar múltiples muestras por pixel
-			for (int s = 0; s < SAMPLES_PER_PIXEL; s++) {
-				// para el pixel actual, computar la dirección que un rayo debe tener
-				Vector cameraRayDir = cx * ( double(x)/w - .5) + cy * ( double(y)/h - .5) + camera.d;
-				
-				// computar el color del pixel para el punto que intersectó el rayo desde la camara
-				Color sampleColor = shade( Ray(camera.o, cameraRayDir.normalize()) );
-				
-				// Acumular el color de la muestra
-				pixelValue = pixelValue + sampleColor;
-			}
-			
-			// Promedio de todas las muestras
-			pixelValue = pixelValue * (1.0 / SAMPLES_PER_PIXEL);
+// Cámara y resolución de una imagen: genera el rayo primario de cada pixel
+struct View {
+	int w, h;       // resolución de la imagen
+	Ray camera;     // posición de la cámara y dirección en que mira
+	Vector cx, cy;  // ejes del plano de la imagen
 
-			// limitar los tres valores de color del pixel a [0,1]
-			pixelColors[idx] = Color(clamp(pixelValue.x), clamp(pixelValue.y), clamp(pixelValue.z));
-		}
+	View(int w_, int h_, const Ray &camera_) : w(w_), h(h_), camera(camera_) {
+		cx = Vector( w * 0.5095 / h, 0., 0.);
+		cy = (cx % camera.d).normalize() * 0.5095;
 	}
 
-	fprintf(stderr,"\n");
+	// rayo desde la cámara para el pixel x,y (y = 0 es el renglón inferior)
+	Ray primaryRay(int x, int y) const {
+		Vector cameraRayDir = cx * ( double(x)/w - .5) + cy * ( double(y)/h - .5) + camera.d;
+		return Ray(camera.o, cameraRayDir.normalize());
+	}
+};
 
-	// PROYECTO 1
-	// Investigar formato ppm
-	FILE *f = fopen("image.ppm", "w");
+// Cámara por defecto de la escena Cornell Box
+View defaultView(int w = 1024, int h = 768) {
+	return View(w, h, Ray( Point(0, 11.2, 214), Vector(0, -0.042612, -1).normalize() ));
+}
+
+// Escribe la imagen en formato ppm (P3)
+// Regresa false si no se pudo escribir el archivo completo
+bool writePPM(const char *path, const Color *pixelColors, int w, int h) {
+	FILE *f = fopen(path, "w");
+	if (!f) {
+		fprintf(stderr, "no se pudo abrir %s: %s\n", path, strerror(errno));
+		return false;
+	}
 	// escribe cabecera del archivo ppm, ancho, alto y valor maximo de color
-	fprintf(f, "P3\n%d %d\n%d\n", w, h, 255); 
-	for (int p = 0; p < w * h; p++) 
+	fprintf(f, "P3\n%d %d\n%d\n", w, h, 255);
+	for (int p = 0; p < w * h; p++)
 	{ // escribe todos los valores de los pixeles
-    		fprintf(f,"%d %d %d ", toDisplayValue(pixelColors[p].x), toDisplayValue(pixelColors[p].y), 
-				toDisplayValue(pixelColors[p].z));
-  	}
-  	fclose(f);
+		fprintf(f,"%d %d %d ", toDisplayValue(pixelColors[p].x), toDisplayValue(pixelColors[p].y),
+			toDisplayValue(pixelColors[p].z));
+	}
+	if (ferror(f) | fclose(f)) {
+		fprintf(stderr, "no se pudo escribir %s\n", path);
+		return false;
+	}
+	return true;
+}
+
+// ---------------------------------------------------------------------------
+// Mapa de fotones
+// ---------------------------------------------------------------------------
+
+// Fotón almacenado en el kd-tree. Se guarda en float para que cada fotón
+// ocupe 40 bytes y la búsqueda recorra memoria contigua.
+struct Photon {
+	float pos[3];   // posición del impacto
+	float dir[3];   // dirección de viaje del fotón al llegar
+	float power[3]; // flujo (potencia) transportado
+	int axis;       // eje de partición del nodo en el kd-tree
+};
+
+// Vecino encontrado durante la búsqueda k-NN
+struct PhotonNeighbor {
+	double dist2;
+	int index;
+	bool operator<(const PhotonNeighbor &b) const { return dist2 < b.dist2; }
+};
+
+// kd-tree balanceado guardado en un arreglo: el nodo de un rango [lo, hi) es
+// el elemento de en medio y sus hijos son los subrangos izquierdo y derecho,
+// así que no se necesitan apuntadores.
+class PhotonMap {
+public:
+	std::vector<Photon> photons;
+
+	void build() { build(0, (int)photons.size()); }
+
+	// Busca los k fotones más cercanos a x dentro de la distancia máxima
+	// (al cuadrado) maxDist2. Regresa en maxDist2 el radio final al cuadrado.
+	void nearest(const Point &x, int k, double &maxDist2, std::vector<PhotonNeighbor> &heap) const {
+		heap.clear();
+		if (!photons.empty())
+			nearest(x, k, 0, (int)photons.size(), maxDist2, heap);
+	}
+
+	// Suma el flujo de todos los fotones a menos de sqrt(radius2) de x que
+	// llegaron por el lado de la normal, sin límite de vecinos
+	Color fluxWithin(const Point &x, const Vector &normal, double radius2) const {
+		Color flux = Color();
+		fluxWithin(x, normal, radius2, 0, (int)photons.size(), flux);
+		return flux;
+	}
+
+private:
+	void build(int lo, int hi) {
+		if (hi - lo <= 1) {
+			if (hi - lo == 1) photons[lo].axis = 0;
+			return;
+		}
+
+		// Elegir el eje de mayor extensión dentro del rango
+		float bmin[3] = { 1e30f, 1e30f, 1e30f }, bmax[3] = { -1e30f, -1e30f, -1e30f };
+		for (int i = lo; i < hi; i++)
+			for (int a = 0; a < 3; a++) {
+				bmin[a] = std::min(bmin[a], photons[i].pos[a]);
+				bmax[a] = std::max(bmax[a], photons[i].pos[a]);
+			}
+		int axis = 0;
+		if (bmax[1] - bmin[1] > bmax[axis] - bmin[axis]) axis = 1;
+		if (bmax[2] - bmin[2] > bmax[axis] - bmin[axis]) axis = 2;
+
+		// Colocar la mediana en medio del rango
+		int mid = (lo + hi) / 2;
+		std::nth_element(photons.begin() + lo, photons.begin() + mid, photons.begin() + hi,
+			[axis](const Photon &a, const Photon &b) { return a.pos[axis] < b.pos[axis]; });
+		photons[mid].axis = axis;
+
+		build(lo, mid);
+		build(mid + 1, hi);
+	}
+
+	void fluxWithin(const Point &x, const Vector &normal, double radius2, int lo, int hi, Color &flux) const {
+		if (lo >= hi) return;
+		int mid = (lo + hi) / 2;
+		const Photon &p = photons[mid];
+		double q[3] = { x.x, x.y, x.z };
+		double delta = q[p.axis] - p.pos[p.axis];
+
+		if (delta < 0 || delta * delta < radius2) fluxWithin(x, normal, radius2, lo, mid, flux);
+		if (delta >= 0 || delta * delta < radius2) fluxWithin(x, normal, radius2, mid + 1, hi, flux);
+
+		double dx = q[0] - p.pos[0], dy = q[1] - p.pos[1], dz = q[2] - p.pos[2];
+		// Descartar fotones que llegaron por el otro lado de la superficie
+		if (dx * dx + dy * dy + dz * dz < radius2 &&
+		    p.dir[0] * normal.x + p.dir[1] * normal.y + p.dir[2] * normal.z < 0)
+			flux = flux + Color(p.power[0], p.power[1], p.power[2]);
+	}
+
+	void nearest(const Point &x, int k, int lo, int hi, double &maxDist2,
+	             std::vector<PhotonNeighbor> &heap) const {
+		if (lo >= hi) return;
+		int mid = (lo + hi) / 2;
+		const Photon &p = photons[mid];
+		double q[3] = { x.x, x.y, x.z };
+		double delta = q[p.axis] - p.pos[p.axis];
+
+		// Visitar primero el lado donde está el punto de consulta
+		if (delta < 0) {
+			nearest(x, k, lo, mid, maxDist2, heap);
+			if (delta * delta < maxDist2) nearest(x, k, mid + 1, hi, maxDist2, heap);
+		} else {
+			nearest(x, k, mid + 1, hi, maxDist2, heap);
+			if (delta * delta < maxDist2) nearest(x, k, lo, mid, maxDist2, heap);
+		}
+
+		double dx = q[0] - p.pos[0], dy = q[1] - p.pos[1], dz = q[2] - p.pos[2];
+		double d2 = dx * dx + dy * dy + dz * dz;
+		if (d2 >= maxDist2) return;
+
+		// Max-heap con los k mejores; al llenarse el radio se reduce al del peor
+		PhotonNeighbor n = { d2, mid };
+		if ((int)heap.size() < k) {
+			heap.push_back(n);
+			std::push_heap(heap.begin(), heap.end());
+		} else {
+			std::pop_heap(heap.begin(), heap.end());
+			heap.back() = n;
+			std::push_heap(heap.begin(), heap.end());
+		}
+		if ((int)heap.size() == k) maxDist2 = heap.front().dist2;
+	}
+};
+
+// Traza fotones desde la esfera emisora y construye el kd-tree. La emisión
+// se reparte entre los hilos de OpenMP y cada hilo guarda sus fotones en un
+// arreglo propio que al final se concatena.
+void emitPhotons(PhotonMap &map, int count) {
+	const Sphere &light = scene->spheres[scene->light];
+	Color Le = scene->emission.mult(light.c);
+
+	// Flujo total de una esfera lambertiana emisora: Φ = Le · π · área
+	Color totalPower = Le * (M_PI * 4.0 * M_PI * light.r * light.r);
+	Color photonPower = totalPower * (1.0 / count);
+
+	map.photons.clear();
+
+	#pragma omp parallel
+	{
+		std::vector<Photon> local;
+
+		#pragma omp for schedule(dynamic, 1024)
+		for (int i = 0; i < count; i++) {
+			// Punto uniforme sobre la esfera y dirección con distribución coseno
+			Vector n = uniform_sphere_sample();
+			Vector d = cosine_hemisphere_sample(n);
+			Ray r(light.p + n * (light.r + 1e-4), d);
+			Color power = photonPower;
+
+			for (int bounce = 0; bounce < PHOTON_MAX_BOUNCES; bounce++) {
+				double t;
+				int id = 0;
+				if (!intersect(r, t, id) || id == scene->light)
+					break;
+
+				const Sphere &obj = scene->spheres[id];
+				Point x = r.o + r.d * t;
+				Vector nl = (x - obj.p).normalize();
+				if (nl.dot(r.d) > 0) nl = nl * -1;
+
+				Photon p;
+				p.pos[0] = x.x; p.pos[1] = x.y; p.pos[2] = x.z;
+				p.dir[0] = r.d.x; p.dir[1] = r.d.y; p.dir[2] = r.d.z;
+				p.power[0] = power.x; p.power[1] = power.y; p.power[2] = power.z;
+				p.axis = 0;
+				local.push_back(p);
+
+				// Ruleta rusa con la reflectancia máxima del material
+				double survive = std::max(obj.c.x, std::max(obj.c.y, obj.c.z));
+				if (uniform_random() >= survive)
+					break;
+				power = power.mult(obj.c) * (1.0 / survive);
+				r = Ray(x + nl * 1e-4, cosine_hemisphere_sample(nl));
+			}
+		}
+
+		#pragma omp critical
+		map.photons.insert(map.photons.end(), local.begin(), local.end());
+	}
+
+	map.build();
+}
+
+// Radiancia reflejada en x estimada con los fotones vecinos (BRDF lambertiana).
+// Con un solo pase se usan los PHOTON_KNN más cercanos dentro de radius2. En
+// modo progresivo se usan todos los fotones dentro de radius2: el radio fijo
+// de cada pase es lo que hace que el promedio de pases converja.
+Color photonRadiance(const PhotonMap &map, const Point &x, const Vector &normal, const Color &albedo,
+                     double radius2, bool progressive, std::vector<PhotonNeighbor> &heap) {
+	if (progressive)
+		return map.fluxWithin(x, normal, radius2).mult(albedo) * (1.0 / (M_PI * M_PI * radius2));
+
+	double r2 = radius2;
+	map.nearest(x, PHOTON_KNN, r2, heap);
+
+	Color flux = Color();
+	for (size_t i = 0; i < heap.size(); i++) {
+		const Photon &p = map.photons[heap[i].index];
+		// Descartar fotones que llegaron por el otro lado de la superficie
+		if (p.dir[0] * normal.x + p.dir[1] * normal.y + p.dir[2] * normal.z >= 0)
+			continue;
+		flux = flux + Color(p.power[0], p.power[1], p.power[2]);
+	}
+
+	return flux.mult(albedo) * (1.0 / (M_PI * M_PI * r2));
+}
+
+// Color del rayo usando el mapa de fotones en el primer impacto
+Color shadePhotons(const Ray &r, const PhotonMap &map, double radius2, bool progressive,
+                   std::vector<PhotonNeighbor> &heap) {
+	double t;
+	int id = 0;
+	if (!intersect(r, t, id))
+		return Color();
+
+	const Sphere &obj = scene->spheres[id];
+	if (id == scene->light)
+		return scene->emission.mult(obj.c);
+
+	Point x = r.o + r.d * t;
+	Vector n = (x - obj.p).normalize();
+	Vector normal = n.dot(r.d) < 0 ? n : n * -1;
+
+	return photonRadiance(map, x, normal, obj.c, radius2, progressive, heap);
+}
+
+// Renderiza la imagen con mapeo de fotones. Con passes > 1 se usa el modo
+// progresivo: cada pase emite un mapa nuevo, el radio se reduce como
+// r²_{i+1} = r²_i (i + α) / (i + 1) y la imagen final es el promedio de los pases.
+void renderPhotonMapping(Color *pixelColors, const View &view, int passes) {
+	int w = view.w, h = view.h;
+	PhotonMap map;
+	double radius2 = PHOTON_RADIUS * PHOTON_RADIUS;
+
+	for (int pass = 0; pass < passes; pass++) {
+		emitPhotons(map, PHOTONS_PER_PASS);
+		fprintf(stderr, "\rpase %d/%d: %d fotones, radio %.3f", pass + 1, passes,
+			(int)map.photons.size(), sqrt(radius2));
+
+		#pragma omp parallel
+		{
+			std::vector<PhotonNeighbor> heap;
+			heap.reserve(PHOTON_KNN);
+
+			#pragma omp for schedule(dynamic, 1)
+			for (int y = 0; y < h; y++) {
+				for (int x = 0; x < w; x++) {
+					int idx = (h - y - 1) * w + x;
+					pixelColors[idx] = pixelColors[idx] + shadePhotons(view.primaryRay(x, y), map, radius2, passes > 1, heap);
+				}
+			}
+		}
+
+		radius2 *= (pass + PHOTON_ALPHA) / (pass + 1.0);
+	}
+
+	for (int p = 0; p < w * h; p++) {
+		Color c = pixelColors[p] * (1.0 / passes);
+		pixelColors[p] = Color(clamp(c.x), clamp(c.y), clamp(c.z));
+	}
+}
+
+
+// ---------------------------------------------------------------------------
+// Render distribuido: coordinador y trabajadores sobre un socket Unix
+// ---------------------------------------------------------------------------
+
+// La imagen se divide en unidades de trabajo: una franja de DIST_BAND_ROWS
+// renglones con DIST_PASS_SPP muestras. Las unidades se reparten primero por
+// pase, así que la imagen completa mejora de manera uniforme.
+const int DIST_BAND_ROWS = 16;
+const int DIST_PASS_SPP = 32;
+// Segundos que un trabajador tiene para regresar una unidad. Si no lo hace
+// (por ejemplo, un proceso detenido), se le desconecta y la unidad vuelve a
+// la cola. Se puede cambiar con --unit-timeout.
+const double DIST_UNIT_TIMEOUT = 120.0;
+
+// Mensaje coordinador -> trabajador. id < 0 indica que no hay más trabajo.
+struct WorkUnit {
+	int id;
+	int w, h;     // resolución completa de la imagen
+	int y0, y1;   // renglones [y0, y1) a renderizar
+	int spp;      // muestras por pixel de este pase
+	int sampling; // SamplingMethod elegido en el coordinador
+};
+
+// Respuesta trabajador -> coordinador. Le siguen (y1 - y0) * w * 3 floats con
+// la suma de radiancia y (y1 - y0) * w enteros con las muestras por pixel.
+struct WorkResult {
+	int id;
+	int y0, y1;
+	int spp;
+};
+
+size_t resultPayloadSize(int rows, int w) {
+	return (size_t)rows * w * (3 * sizeof(float) + sizeof(unsigned));
+}
+
+bool readAll(int fd, void *buf, size_t size) {
+	char *p = (char *)buf;
+	while (size > 0) {
+		ssize_t n = read(fd, p, size);
+		if (n < 0 && errno == EINTR) continue;
+		if (n <= 0) return false;
+		p += n;
+		size -= n;
+	}
+	return true;
+}
+
+bool writeAll(int fd, const void *buf, size_t size) {
+	const char *p = (const char *)buf;
+	while (size > 0) {
+		ssize_t n = send(fd, p, size, MSG_NOSIGNAL);
+		if (n < 0 && errno == EINTR) continue;
+		if (n <= 0) return false;
+		p += n;
+		size -= n;
+	}
+	return true;
+}
+
+// Acumula spp muestras por pixel para los renglones [y0, y1). Los arreglos
+// están indexados por (y - y0) * w + x, sin invertir el renglón.
+// Las franjas son angostas (DIST_BAND_ROWS o DAEMON_TILE_ROWS renglones): si
+// solo se repartieran renglones, más de 16 hilos quedarían ociosos. Por eso
+// se reparten trozos de 64 pixeles de los dos ciclos juntos.
+void renderBand(const View &view, int y0, int y1, int spp, float *sums, unsigned *counts) {
+	#pragma omp parallel for collapse(2) schedule(dynamic, 64)
+	for (int y = y0; y < y1; y++) {
+		for (int x = 0; x < view.w; x++) {
+			Color pixelValue = Color();
+			for (int s = 0; s < spp; s++)
+				pixelValue = pixelValue + shade(view.primaryRay(x, y));
+
+			int i = (y - y0) * view.w + x;
+			sums[3 * i + 0] = pixelValue.x;
+			sums[3 * i + 1] = pixelValue.y;
+			sums[3 * i + 2] = pixelValue.z;
+			counts[i] = spp;
+		}
+	}
+}
+
+int connectUnix(const char *path) {
+	int fd = socket(AF_UNIX, SOCK_STREAM, 0);
+	if (fd < 0) return -1;
+	sockaddr_un addr;
+	memset(&addr, 0, sizeof(addr));
+	addr.sun_family = AF_UNIX;
+	strncpy(addr.sun_path, path, sizeof(addr.sun_path) - 1);
+	if (connect(fd, (sockaddr *)&addr, sizeof(addr)) < 0) {
+		close(fd);
+		return -1;
+	}
+	return fd;
+}
+
+// Solo se reemplaza un socket viejo; cualquier otro archivo en la ruta se
+// respeta y se regresa -1 con errno = EEXIST.
+int listenUnix(const char *path) {
+	struct stat st;
+	if (lstat(path, &st) == 0 && !S_ISSOCK(st.st_mode)) {
+		errno = EEXIST;
+		return -1;
+	}
+	int fd = socket(AF_UNIX, SOCK_STREAM, 0);
+	if (fd < 0) return -1;
+	sockaddr_un addr;
+	memset(&addr, 0, sizeof(addr));
+	addr.sun_family = AF_UNIX;
+	strncpy(addr.sun_path, path, sizeof(addr.sun_path) - 1);
+	unlink(path);
+	if (bind(fd, (sockaddr *)&addr, sizeof(addr)) < 0 || listen(fd, 64) < 0) {
+		close(fd);
+		return -1;
+	}
+	return fd;
+}
 
-  	delete[] pixelColors;
+// Trabajador: pide unidades al coordinador hasta que ya no haya trabajo o
+// el coordinador desaparezca.
+int runWorker(const char *socketPath) {
+	int fd = connectUnix(socketPath);
+	if (fd < 0) {
+		fprintf(stderr, "no se pudo conectar a %s: %s\n", socketPath, strerror(errno));
+		return 1;
+	}
+
+	std::vector<float> sums;
+	std::vector<unsigned> counts;
+	WorkUnit unit;
+	int done = 0;
+
+	while (readAll(fd, &unit, sizeof(unit)) && unit.id >= 0) {
+		if (unit.sampling < UNIFORM_SPHERE || unit.sampling > COSINE_HEMISPHERE)
+			break;
+		samplingMethod = (SamplingMethod)unit.sampling;
+		View view = defaultView(unit.w, unit.h);
+		int rows = unit.y1 - unit.y0;
+		sums.assign((size_t)rows * unit.w * 3, 0.0f);
+		counts.assign((size_t)rows * unit.w, 0);
+
+		renderBand(view, unit.y0, unit.y1, unit.spp, sums.data(), counts.data());
 
+		WorkResult result = { unit.id, unit.y0, unit.y1, unit.spp };
+		if (!writeAll(fd, &result, sizeof(result)) ||
+		    !writeAll(fd, sums.data(), sums.size() * sizeof(float)) ||
+		    !writeAll(fd, counts.data(), counts.size() * sizeof(unsigned)))
+			break;
+		done++;
+	}
+
+	fprintf(stderr, "trabajador: %d unidades completadas\n", done);
+	close(fd);
 	return 0;
 }
+
+// Estado del coordinador para cada trabajador conectado
+struct WorkerConnection {
+	int fd;
+	int unit;                 // unidad asignada, -1 si está libre
+	double deadline;          // omp_get_wtime() límite para entregar la unidad
+	std::vector<char> buffer; // respuesta recibida hasta ahora
+};
+
+// Coordinador: reparte las unidades, fusiona los buffers de acumulación y
+// escribe la imagen. Los trabajadores pueden conectarse en cualquier momento;
+// si uno se desconecta o no entrega su unidad en unitTimeout segundos, la
+// unidad vuelve a la cola.
+int runCoordinator(const char *socketPath, const char *outputPath, int w, int h, int spp,
+                   double unitTimeout) {
+	int listenFd = listenUnix(socketPath);
+	if (listenFd < 0) {
+		fprintf(stderr, "no se pudo escuchar en %s: %s\n", socketPath, strerror(errno));
+		return 1;
+	}
+	signal(SIGPIPE, SIG_IGN);
+
+	// Lista de unidades: pase mayor, franja menor
+	std::vector<WorkUnit> units;
+	for (int done = 0; done < spp; done += DIST_PASS_SPP)
+		for (int y0 = 0; y0 < h; y0 += DIST_BAND_ROWS) {
+			WorkUnit u = { (int)units.size(), w, h, y0, std::min(y0 + DIST_BAND_ROWS, h),
+			               std::min(DIST_PASS_SPP, spp - done), samplingMethod };
+			units.push_back(u);
+		}
+
+	std::deque<int> pending;
+	for (size_t i = 0; i < units.size(); i++) pending.push_back(i);
+	std::vector<bool> finished(units.size(), false);
+	int remaining = units.size();
+
+	std::vector<float> accum((size_t)w * h * 3, 0.0f);
+	std::vector<unsigned> counts((size_t)w * h, 0);
+	std::vector<WorkerConnection> workers;
+
+	fprintf(stderr, "coordinador: %d unidades en %s\n", remaining, socketPath);
+
+	while (remaining > 0) {
+		// Asignar trabajo a los trabajadores libres
+		for (size_t i = 0; i < workers.size(); i++) {
+			WorkerConnection &c = workers[i];
+			if (c.unit >= 0 || pending.empty()) continue;
+			c.unit = pending.front();
+			pending.pop_front();
+			c.deadline = omp_get_wtime() + unitTimeout;
+			c.buffer.clear();
+			if (!writeAll(c.fd, &units[c.unit], sizeof(WorkUnit))) {
+				pending.push_front(c.unit);
+				c.unit = -1;
+			}
+		}
+
+		std::vector<pollfd> fds(1 + workers.size());
+		fds[0].fd = listenFd;
+		fds[0].events = POLLIN;
+		// Despertar a tiempo para el primer plazo que venza
+		double now = omp_get_wtime(), nextDeadline = -1;
+		for (size_t i = 0; i < workers.size(); i++) {
+			fds[i + 1].fd = workers[i].fd;
+			fds[i + 1].events = POLLIN;
+			if (workers[i].unit >= 0 && (nextDeadline < 0 || workers[i].deadline < nextDeadline))
+				nextDeadline = workers[i].deadline;
+		}
+		int timeout = nextDeadline < 0 ? -1 : (int)ceil(std::max(0.0, nextDeadline - now) * 1000);
+		if (poll(fds.data(), fds.size(), timeout) < 0) {
+			if (errno == EINTR) continue;
+			perror("poll");
+			break;
+		}
+
+		std::vector<bool> dead(workers.size(), false), expired(workers.size(), false);
+		for (size_t i = 0; i < workers.size(); i++) {
+			if (!(fds[i + 1].revents & (POLLIN | POLLHUP | POLLERR))) continue;
+			WorkerConnection &c = workers[i];
+
+			char chunk[1 << 16];
+			ssize_t n = read(c.fd, chunk, sizeof(chunk));
+			if (n <= 0 || c.unit < 0) {
+				dead[i] = true;
+				continue;
+			}
+			c.buffer.insert(c.buffer.end(), chunk, chunk + n);
+
+			const WorkUnit &u = units[c.unit];
+			int rows = u.y1 - u.y0;
+			size_t expected = sizeof(WorkResult) + resultPayloadSize(rows, w);
+			if (c.buffer.size() < expected) continue;
+
+			WorkResult result;
+			memcpy(&result, c.buffer.data(), sizeof(result));
+			if (result.id != u.id || c.buffer.size() != expected) {
+				dead[i] = true;
+				continue;
+			}
+
+			// Fusionar la franja en el buffer de acumulación
+			const float *sums = (const float *)(c.buffer.data() + sizeof(WorkResult));
+			const unsigned *cnt = (const unsigned *)(sums + (size_t)rows * w * 3);
+			for (int y = u.y0; y < u.y1; y++)
+				for (int x = 0; x < w; x++) {
+					int src = (y - u.y0) * w + x;
+					int idx = (h - y - 1) * w + x;
+					accum[3 * idx + 0] += sums[3 * src + 0];
+					accum[3 * idx + 1] += sums[3 * src + 1];
+					accum[3 * idx + 2] += sums[3 * src + 2];
+					counts[idx] += cnt[src];
+				}
+
+			if (!finished[u.id]) {
+				finished[u.id] = true;
+				remaining--;
+			}
+			c.unit = -1;
+			c.buffer.clear();
+			fprintf(stderr, "\r%5.2f%% (%d trabajadores)", 100. * (units.size() - remaining) / units.size(),
+				(int)workers.size());
+		}
+
+		// Un trabajador vivo pero atorado pierde su unidad al vencer el plazo
+		now = omp_get_wtime();
+		for (size_t i = 0; i < workers.size(); i++)
+			if (!dead[i] && workers[i].unit >= 0 && now >= workers[i].deadline)
+				dead[i] = expired[i] = true;
+
+		// Los trabajadores caídos devuelven su unidad a la cola
+		for (int i = (int)workers.size() - 1; i >= 0; i--) {
+			if (!dead[i]) continue;
+			if (workers[i].unit >= 0) {
+				pending.push_front(workers[i].unit);
+				fprintf(stderr, "\ntrabajador %s, unidad %d en cola de nuevo\n",
+					expired[i] ? "sin respuesta" : "perdido", workers[i].unit);
+			}
+			close(workers[i].fd);
+			workers.erase(workers.begin() + i);
+		}
+
+		if (fds[0].revents & POLLIN) {
+			int fd = accept(listenFd, NULL, NULL);
+			if (fd >= 0) {
+				WorkerConnection c;
+				c.fd = fd;
+				c.unit = -1;
+				c.deadline = 0;
+				workers.push_back(c);
+			}
+		}
+	}
+
+	// Avisar a los trabajadores que terminaron
+	WorkUnit stop = { -1, w, h, 0, 0, 0, samplingMethod };
+	for (size_t i = 0; i < workers.size(); i++) {
+		writeAll(workers[i].fd, &stop, sizeof(stop));
+		close(workers[i].fd);
+	}
+	close(listenFd);
+	unlink(socketPath);
+	fprintf(stderr, "\n");
+
+	Color *pixelColors = new Color[w * h];
+	for (int p = 0; p < w * h; p++) {
+		double inv = counts[p] > 0 ? 1.0 / counts[p] : 0.0;
+		pixelColors[p] = Color(clamp(accum[3 * p] * inv), clamp(accum[3 * p + 1] * inv), clamp(accum[3 * p + 2] * inv));
+	}
+	bool written = writePPM(outputPath, pixelColors, w, h);
+	delete[] pixelColors;
+
+	return remaining == 0 && written ? 0 : 1;
+}
+
+// ---------------------------------------------------------------------------
+// Servicio de render: cola de trabajos con prioridades sobre un socket Unix
+// ---------------------------------------------------------------------------
+
+// El servicio renderiza franjas de DAEMON_TILE_ROWS renglones. Entre franjas
+// atiende conexiones, así que cancelar un trabajo o adelantarle otro de mayor
+// prioridad ocurre con granularidad de franja y sin perder lo ya renderizado.
+const int DAEMON_TILE_ROWS = 16;
+// Máximo de pixeles por trabajo. Cada pixel ocupa 16 bytes mientras el
+// trabajo está en cola, así que el límite equivale a 4 GB.
+const long long DAEMON_MAX_PIXELS = 1LL << 28;
+
+// Carga una escena de texto. Formato, una entrada por renglón:
+//   sphere r px py pz cr cg cb
+//   light <índice de la esfera> er eg eb
+// Los renglones que empiezan con # se ignoran.
+bool loadScene(const char *path, Scene &out, std::string &error) {
+	FILE *f = fopen(path, "r");
+	if (!f) {
+		error = std::string("no se pudo abrir ") + path;
+		return false;
+	}
+
+	out.spheres.clear();
+	out.light = -1;
+	char line[512];
+	int lineNumber = 0;
+	while (fgets(line, sizeof(line), f)) {
+		lineNumber++;
+		char kind[16];
+		double v[7];
+		int index;
+		if (sscanf(line, " %15s", kind) != 1 || kind[0] == '#')
+			continue;
+		if (strcmp(kind, "sphere") == 0 &&
+		    sscanf(line, " sphere %lf %lf %lf %lf %lf %lf %lf", &v[0], &v[1], &v[2], &v[3], &v[4], &v[5], &v[6]) == 7)
+			out.spheres.push_back(Sphere(v[0], Point(v[1], v[2], v[3]), Color(v[4], v[5], v[6])));
+		else if (strcmp(kind, "light") == 0 &&
+		         sscanf(line, " light %d %lf %lf %lf", &index, &v[0], &v[1], &v[2]) == 4) {
+			out.light = index;
+			out.emission = Vector(v[0], v[1], v[2]);
+		} else {
+			error = std::string(path) + ": renglón " + std::to_string(lineNumber) + " inválido";
+			fclose(f);
+			return false;
+		}
+	}
+	fclose(f);
+
+	if (out.light < 0 || out.light >= (int)out.spheres.size()) {
+		error = std::string(path) + ": falta una fuente de luz válida";
+		return false;
+	}
+	return true;
+}
+
+// Trabajo en la cola del servicio
+struct RenderJob {
+	int id;
+	int priority;        // mayor valor, mayor prioridad
+	View view;
+	int spp;
+	std::string output;
+	std::shared_ptr<const Scene> scene;  // se conserva aunque el archivo se recargue
+	std::vector<float> sums;     // acumulación por pixel (ver renderBand)
+	std::vector<unsigned> counts;
+	int nextRow;         // siguiente franja a renderizar
+	int clientFd;        // conexión que recibe el aviso de terminación
+	double start;
+
+	RenderJob(const View &view_) : view(view_) {}
+};
+
+// Conexión que todavía no envía un comando completo
+struct DaemonClient {
+	int fd;
+	std::string line;
+};
+
+// Escena cargada de un archivo, con la fecha de modificación y el tamaño que
+// tenía el archivo al leerlo
+struct CachedScene {
+	std::shared_ptr<const Scene> scene;
+	struct timespec mtime;
+	off_t size;
+};
+
+// Estado que el servicio conserva entre trabajos: escenas ya cargadas y la
+// cola. El equipo de hilos de OpenMP también se reutiliza de un trabajo a otro.
+struct RenderDaemon {
+	std::map<std::string, CachedScene> scenes;
+	std::list<RenderJob> jobs;
+	std::vector<DaemonClient> clients;
+	int nextId;
+	bool running;
+
+	RenderDaemon() : nextId(1), running(true) {}
+};
+
+void reply(int fd, const char *format, ...) __attribute__((format(printf, 2, 3)));
+void reply(int fd, const char *format, ...) {
+	char buf[512];
+	va_list args;
+	va_start(args, format);
+	vsnprintf(buf, sizeof(buf), format, args);
+	va_end(args);
+	writeAll(fd, buf, strlen(buf));
+}
+
+// Separa los argumentos de un comando por espacios. Las comillas dobles
+// agrupan texto con espacios (clave="valor con espacios") y, dentro de ellas,
+// \" \\ y \n representan una comilla, una diagonal invertida y un salto de línea.
+bool splitArguments(const char *text, std::vector<std::string> &args) {
+	args.clear();
+	const char *c = text;
+	while (*c) {
+		while (*c == ' ' || *c == '\t' || *c == '\r' || *c == '\n') c++;
+		if (!*c) break;
+
+		std::string arg;
+		bool quoted = false;
+		for (; *c && (quoted || (*c != ' ' && *c != '\t' && *c != '\r' && *c != '\n')); c++) {
+			if (*c == '"')
+				quoted = !quoted;
+			else if (quoted && *c == '\\' && c[1]) {
+				c++;
+				arg.push_back(*c == 'n' ? '\n' : *c);
+			} else
+				arg.push_back(*c);
+		}
+		if (quoted) return false;   // comilla sin cerrar
+		args.push_back(arg);
+	}
+	return true;
+}
+
+// Inverso de splitArguments para un valor: lo encierra entre comillas
+std::string quoteArgument(const std::string &value) {
+	std::string quoted = "\"";
+	for (size_t i = 0; i < value.size(); i++) {
+		if (value[i] == '"' || value[i] == '\\') quoted.push_back('\\');
+		if (value[i] == '\n') quoted += "\\n";
+		else quoted.push_back(value[i]);
+	}
+	return quoted + "\"";
+}
+
+// Interpreta "RENDER clave=valor ..." y agrega el trabajo a la cola
+bool queueJob(RenderDaemon &daemon, const char *text, int fd) {
+	int w = 1024, h = 768, spp = SAMPLES_PER_PIXEL, priority = 0;
+	std::string output = "image.ppm", scenePath;
+	View view = defaultView();
+	double c[6];
+	bool customCamera = false;
+
+	std::vector<std::string> args;
+	if (!splitArguments(text, args)) {
+		reply(fd, "ERROR comilla sin cerrar\n");
+		return false;
+	}
+
+	for (size_t i = 0; i < args.size(); i++) {
+		const char *tok = args[i].c_str();
+		if (sscanf(tok, "spp=%d", &spp) == 1 || sscanf(tok, "priority=%d", &priority) == 1 ||
+		    sscanf(tok, "size=%dx%d", &w, &h) == 2)
+			continue;
+		if (strncmp(tok, "output=", 7) == 0)
+			output = tok + 7;
+		else if (strncmp(tok, "scene=", 6) == 0)
+			scenePath = tok + 6;
+		else if (sscanf(tok, "camera=%lf,%lf,%lf,%lf,%lf,%lf", &c[0], &c[1], &c[2], &c[3], &c[4], &c[5]) == 6)
+			customCamera = true;
+		else {
+			reply(fd, "ERROR parámetro inválido: %s\n", tok);
+			return false;
+		}
+	}
+	if (w <= 0 || h <= 0 || spp <= 0) {
+		reply(fd, "ERROR resolución o spp inválidos\n");
+		return false;
+	}
+	if ((long long)w * h > DAEMON_MAX_PIXELS) {
+		reply(fd, "ERROR resolución demasiado grande: %dx%d\n", w, h);
+		return false;
+	}
+
+	// Las escenas se quedan en memoria y solo se vuelven a leer si el archivo
+	// cambió. Los trabajos ya en cola conservan la versión con la que llegaron.
+	// La Cornell Box compilada no se libera nunca (constructor de alias).
+	std::shared_ptr<const Scene> jobScene(std::shared_ptr<const Scene>(), &cornellBox);
+	if (!scenePath.empty()) {
+		struct stat st;
+		if (stat(scenePath.c_str(), &st) != 0) {
+			reply(fd, "ERROR no se pudo abrir %s\n", scenePath.c_str());
+			return false;
+		}
+		std::map<std::string, CachedScene>::iterator it = daemon.scenes.find(scenePath);
+		bool stale = it == daemon.scenes.end() || it->second.size != st.st_size ||
+		             it->second.mtime.tv_sec != st.st_mtim.tv_sec || it->second.mtime.tv_nsec != st.st_mtim.tv_nsec;
+		if (stale) {
+			std::shared_ptr<Scene> loaded(new Scene());
+			std::string error;
+			if (!loadScene(scenePath.c_str(), *loaded, error)) {
+				reply(fd, "ERROR %s\n", error.c_str());
+				return false;
+			}
+			CachedScene cached = { loaded, st.st_mtim, st.st_size };
+			if (it != daemon.scenes.end())
+				fprintf(stderr, "escena %s modificada, recargada\n", scenePath.c_str());
+			it = daemon.scenes.insert(std::make_pair(scenePath, cached)).first;
+			it->second = cached;
+		}
+		jobScene = it->second.scene;
+	}
+
+	view = customCamera ? View(w, h, Ray(Point(c[0], c[1], c[2]), Vector(c[3], c[4], c[5]).normalize()))
+	                    : defaultView(w, h);
+
+	// Sin memoria para el trabajo se rechaza solo ese, el servicio sigue
+	std::vector<float> sums;
+	std::vector<unsigned> counts;
+	try {
+		sums.assign((size_t)w * h * 3, 0.0f);
+		counts.assign((size_t)w * h, 0u);
+	} catch (const std::bad_alloc &) {
+		reply(fd, "ERROR sin memoria para %dx%d\n", w, h);
+		return false;
+	}
+
+	daemon.jobs.push_back(RenderJob(view));
+	RenderJob &job = daemon.jobs.back();
+	job.id = daemon.nextId++;
+	job.priority = priority;
+	job.spp = spp;
+	job.output = output;
+	job.scene = jobScene;
+	job.sums.swap(sums);
+	job.counts.swap(counts);
+	job.nextRow = 0;
+	job.clientFd = fd;
+	job.start = omp_get_wtime();
+
+	reply(fd, "QUEUED %d\n", job.id);
+	return true;
+}
+
+void finishJob(RenderJob &job) {
+	int w = job.view.w, h = job.view.h;
+	Color *pixelColors = new (std::nothrow) Color[w * h];
+	if (!pixelColors) {
+		reply(job.clientFd, "ERROR sin memoria para escribir %s\n", job.output.c_str());
+		close(job.clientFd);
+		return;
+	}
+	for (int y = 0; y < h; y++)
+		for (int x = 0; x < w; x++) {
+			int i = y * w + x;
+			double inv = job.counts[i] > 0 ? 1.0 / job.counts[i] : 0.0;
+			pixelColors[(h - y - 1) * w + x] = Color(clamp(job.sums[3 * i] * inv),
+				clamp(job.sums[3 * i + 1] * inv), clamp(job.sums[3 * i + 2] * inv));
+		}
+	bool written = writePPM(job.output.c_str(), pixelColors, w, h);
+	delete[] pixelColors;
+
+	if (written)
+		reply(job.clientFd, "DONE %d %.3f\n", job.id, omp_get_wtime() - job.start);
+	else
+		reply(job.clientFd, "ERROR no se pudo escribir %s\n", job.output.c_str());
+	close(job.clientFd);
+}
+
+void cancelJob(RenderDaemon &daemon, int id, int fd) {
+	for (std::list<RenderJob>::iterator it = daemon.jobs.begin(); it != daemon.jobs.end(); ++it) {
+		if (it->id != id) continue;
+		reply(it->clientFd, "CANCELLED %d\n", id);
+		close(it->clientFd);
+		daemon.jobs.erase(it);
+		reply(fd, "OK\n");
+		return;
+	}
+	reply(fd, "ERROR no existe el trabajo %d\n", id);
+}
+
+// Atiende un comando completo. Regresa true si la conexión pasa a un trabajo.
+bool handleCommand(RenderDaemon &daemon, std::string &line, int fd) {
+	std::vector<char> buf(line.begin(), line.end());
+	buf.push_back('\0');
+	char *cmd = buf.data();
+	int id;
+
+	if (strncmp(cmd, "RENDER", 6) == 0)
+		return queueJob(daemon, cmd + 6, fd);
+
+	if (sscanf(cmd, "CANCEL %d", &id) == 1)
+		cancelJob(daemon, id, fd);
+	else if (strncmp(cmd, "STATUS", 6) == 0) {
+		for (std::list<RenderJob>::iterator it = daemon.jobs.begin(); it != daemon.jobs.end(); ++it)
+			reply(fd, "JOB %d priority=%d progress=%.1f%% output=%s\n", it->id, it->priority,
+				100.0 * it->nextRow / it->view.h, it->output.c_str());
+		reply(fd, "OK\n");
+	} else if (strncmp(cmd, "SHUTDOWN", 8) == 0) {
+		daemon.running = false;
+		reply(fd, "OK\n");
+	} else
+		reply(fd, "ERROR comando desconocido\n");
+	return false;
+}
+
+// Acepta conexiones y lee comandos. Si timeout es 0 solo revisa lo pendiente.
+void serviceConnections(RenderDaemon &daemon, int listenFd, int timeout) {
+	std::vector<pollfd> fds;
+	pollfd p = { listenFd, POLLIN, 0 };
+	fds.push_back(p);
+	for (size_t i = 0; i < daemon.clients.size(); i++) {
+		p.fd = daemon.clients[i].fd;
+		fds.push_back(p);
+	}
+	// Si el cliente de un trabajo cierra la conexión, el trabajo se cancela
+	for (std::list<RenderJob>::iterator it = daemon.jobs.begin(); it != daemon.jobs.end(); ++it) {
+		p.fd = it->clientFd;
+		fds.push_back(p);
+	}
+
+	if (poll(fds.data(), fds.size(), timeout) <= 0)
+		return;
+
+	size_t nClients = daemon.clients.size();
+	std::list<RenderJob>::iterator job = daemon.jobs.begin();
+	for (size_t i = 1 + nClients; i < fds.size(); i++) {
+		std::list<RenderJob>::iterator current = job++;
+		if (fds[i].revents & (POLLIN | POLLHUP | POLLERR)) {
+			char c;
+			if (read(current->clientFd, &c, 1) <= 0) {
+				close(current->clientFd);
+				daemon.jobs.erase(current);
+			}
+		}
+	}
+
+	for (int i = (int)nClients - 1; i >= 0; i--) {
+		if (!(fds[i + 1].revents & (POLLIN | POLLHUP | POLLERR))) continue;
+		DaemonClient &c = daemon.clients[i];
+		char chunk[1024];
+		ssize_t n = read(c.fd, chunk, sizeof(chunk));
+		if (n <= 0) {
+			close(c.fd);
+			daemon.clients.erase(daemon.clients.begin() + i);
+			continue;
+		}
+		c.line.append(chunk, n);
+		size_t end = c.line.find('\n');
+		if (end == std::string::npos) continue;
+
+		std::string command = c.line.substr(0, end);
+		int fd = c.fd;
+		daemon.clients.erase(daemon.clients.begin() + i);
+		if (!handleCommand(daemon, command, fd))
+			close(fd);
+	}
+
+	if (fds[0].revents & POLLIN) {
+		int fd = accept(listenFd, NULL, NULL);
+		if (fd >= 0) {
+			DaemonClient c;
+			c.fd = fd;
+			daemon.clients.push_back(c);
+		}
+	}
+}
+
+int runDaemon(const char *socketPath) {
+	int listenFd = listenUnix(socketPath);
+	if (listenFd < 0) {
+		fprintf(stderr, "no se pudo escuchar en %s: %s\n", socketPath, strerror(errno));
+		return 1;
+	}
+	signal(SIGPIPE, SIG_IGN);
+	fprintf(stderr, "servicio de render en %s (%d hilos)\n", socketPath, omp_get_max_threads());
+
+	RenderDaemon daemon;
+	while (daemon.running) {
+		serviceConnections(daemon, listenFd, daemon.jobs.empty() ? -1 : 0);
+		if (daemon.jobs.empty())
+			continue;
+
+		// Mayor prioridad primero; a igual prioridad, el más antiguo
+		std::list<RenderJob>::iterator job = daemon.jobs.begin();
+		for (std::list<RenderJob>::iterator it = daemon.jobs.begin(); it != daemon.jobs.end(); ++it)
+			if (it->priority > job->priority)
+				job = it;
+
+		int y0 = job->nextRow, y1 = std::min(y0 + DAEMON_TILE_ROWS, job->view.h);
+		scene = job->scene.get();
+		renderBand(job->view, y0, y1, job->spp, job->sums.data() + (size_t)y0 * job->view.w * 3,
+			job->counts.data() + (size_t)y0 * job->view.w);
+		scene = &cornellBox;
+		job->nextRow = y1;
+
+		if (job->nextRow >= job->view.h) {
+			finishJob(*job);
+			daemon.jobs.erase(job);
+		}
+	}
+
+	for (std::list<RenderJob>::iterator it = daemon.jobs.begin(); it != daemon.jobs.end(); ++it) {
+		reply(it->clientFd, "CANCELLED %d\n", it->id);
+		close(it->clientFd);
+	}
+	close(listenFd);
+	unlink(socketPath);
+	return 0;
+}
+
+// Cliente del servicio: envía un comando e imprime las respuestas hasta que
+// el servicio cierra la conexión.
+int runClient(const char *socketPath, const std::string &command) {
+	int fd = connectUnix(socketPath);
+	if (fd < 0) {
+		fprintf(stderr, "no se pudo conectar a %s: %s\n", socketPath, strerror(errno));
+		return 1;
+	}
+	std::string line = command + "\n";
+	if (!writeAll(fd, line.data(), line.size())) {
+		close(fd);
+		return 1;
+	}
+
+	std::string last;
+	char chunk[1024];
+	ssize_t n;
+	while ((n = read(fd, chunk, sizeof(chunk))) > 0) {
+		fwrite(chunk, 1, n, stdout);
+		fflush(stdout);
+		last.append(chunk, n);
+	}
+	close(fd);
+
+	// Éxito si la última respuesta fue DONE u OK
+	size_t start = last.rfind('\n', last.size() >= 2 ? last.size() - 2 : 0);
+	start = start == std::string::npos ? 0 : start + 1;
+	return last.compare(start, 4, "DONE") == 0 || last.compare(start, 2, "OK") == 0 ? 0 : 1;
+}
+
+// Convierte una ruta relativa a absoluta para que el servicio la resuelva
+// igual sin importar su directorio de trabajo.
+std::string absolutePath(const char *path) {
+	if (path[0] == '/') return path;
+	char cwd[4096];
+	if (!getcwd(cwd, sizeof(cwd))) return path;
+	return std::string(cwd) + "/" + path;
+}
+
+// ---------------------------------------------------------------------------
+// Convergencia: error contra una referencia en función del tiempo y los rayos
+// ---------------------------------------------------------------------------
+
+// Nombres de los métodos de muestreo en la línea de comandos y en el CSV
+const char *SAMPLING_NAMES[] = { "uniform-sphere", "uniform-hemisphere", "cosine-hemisphere" };
+
+bool parseSamplingMethod(const char *name, SamplingMethod &method) {
+	for (int i = 0; i < 3; i++)
+		if (strcmp(name, SAMPLING_NAMES[i]) == 0) {
+			method = (SamplingMethod)i;
+			return true;
+		}
+	return false;
+}
+
+// Imagen en float sin limitar a [0,1], guardada como PFM para reutilizarla.
+// Los pixeles siguen el orden de pixelColors (primer renglón arriba). tag se
+// guarda en un comentario "# ..." después de "PF" y describe cómo se generó.
+bool writePFM(const char *path, const std::vector<Color> &img, int w, int h, const std::string &tag) {
+	FILE *f = fopen(path, "wb");
+	if (!f) return false;
+	fprintf(f, "PF\n# %s\n%d %d\n-1.0\n", tag.c_str(), w, h);
+	std::vector<float> row(w * 3);
+	for (int y = h - 1; y >= 0; y--) {   // PFM guarda primero el renglón inferior
+		for (int x = 0; x < w; x++) {
+			const Color &c = img[y * w + x];
+			row[3 * x] = c.x; row[3 * x + 1] = c.y; row[3 * x + 2] = c.z;
+		}
+		fwrite(row.data(), sizeof(float), row.size(), f);
+	}
+	fclose(f);
+	return true;
+}
+
+// Solo acepta la imagen si su resolución y su comentario coinciden con w, h y tag
+bool readPFM(const char *path, std::vector<Color> &img, int w, int h, const std::string &tag) {
+	FILE *f = fopen(path, "rb");
+	if (!f) return false;
+	int fw, fh;
+	float scale;
+	char comment[4096] = "";
+	bool ok = fscanf(f, "PF\n# %4095[^\n]", comment) == 1 && tag == comment &&
+	          fscanf(f, "%d %d %f", &fw, &fh, &scale) == 3 && fgetc(f) != EOF &&
+	          fw == w && fh == h && scale < 0;
+	std::vector<float> row(w * 3);
+	img.assign(w * h, Color());
+	for (int y = h - 1; ok && y >= 0; y--) {
+		ok = fread(row.data(), sizeof(float), row.size(), f) == row.size();
+		for (int x = 0; ok && x < w; x++)
+			img[y * w + x] = Color(row[3 * x], row[3 * x + 1], row[3 * x + 2]);
+	}
+	fclose(f);
+	return ok;
+}
+
+// Acumula una muestra por pixel sobre toda la imagen y regresa los rayos trazados
+unsigned long long renderPass(const View &view, std::vector<Color> &sums) {
+	unsigned long long rays = 0;
+	int w = view.w, h = view.h;
+
+	#pragma omp parallel reduction(+:rays)
+	{
+		unsigned long long before = rayCount;
+		#pragma omp for schedule(dynamic, 1)
+		for (int y = 0; y < h; y++)
+			for (int x = 0; x < w; x++) {
+				int idx = (h - y - 1) * w + x;
+				sums[idx] = sums[idx] + shade(view.primaryRay(x, y));
+			}
+		rays += rayCount - before;
+	}
+	return rays;
+}
+
+// Color lineal en [0,1] -> CIELAB, pasando por la misma curva de despliegue
+// que toDisplayValue (gamma 2.2) y tratando el resultado como sRGB.
+Vector displayLab(const Color &c) {
+	double rgb[3] = { pow(clamp(c.x), 1.0/2.2), pow(clamp(c.y), 1.0/2.2), pow(clamp(c.z), 1.0/2.2) };
+	for (int i = 0; i < 3; i++)
+		rgb[i] = rgb[i] <= 0.04045 ? rgb[i] / 12.92 : pow((rgb[i] + 0.055) / 1.055, 2.4);
+
+	double X = (0.4124 * rgb[0] + 0.3576 * rgb[1] + 0.1805 * rgb[2]) / 0.95047;
+	double Y =  0.2126 * rgb[0] + 0.7152 * rgb[1] + 0.0722 * rgb[2];
+	double Z = (0.0193 * rgb[0] + 0.1192 * rgb[1] + 0.9505 * rgb[2]) / 1.08883;
+	double fx = X > 0.008856 ? cbrt(X) : 7.787 * X + 16.0 / 116;
+	double fy = Y > 0.008856 ? cbrt(Y) : 7.787 * Y + 16.0 / 116;
+	double fz = Z > 0.008856 ? cbrt(Z) : 7.787 * Z + 16.0 / 116;
+	return Vector(116 * fy - 16, 500 * (fx - fy), 200 * (fy - fz));
+}
+
+// Distancia HyAB (|ΔL| + distancia euclidiana en a,b), la métrica de color de FLIP
+double hyab(const Vector &a, const Vector &b) {
+	return fabs(a.x - b.x) + sqrt((a.y - b.y) * (a.y - b.y) + (a.z - b.z) * (a.z - b.z));
+}
+
+struct ErrorMetrics {
+	double rmse;    // raíz del error cuadrático medio en radiancia lineal
+	double relmse;  // error cuadrático relativo: (x - ref)² / (ref² + 0.01)
+	double flip;    // error perceptual estilo FLIP en [0, 1]
+};
+
+// El término "flip" es una versión simplificada de FLIP: filtra ambas imágenes
+// desplegadas con un kernel gaussiano 3x3, mide la diferencia HyAB en CIELAB
+// normalizada por la distancia entre verde y azul puros, y promedia. No incluye
+// el término de bordes y puntos del FLIP completo.
+ErrorMetrics computeErrors(const std::vector<Color> &img, const std::vector<Color> &ref, int w, int h) {
+	ErrorMetrics m = { 0, 0, 0 };
+	for (int p = 0; p < w * h; p++) {
+		double d[3] = { img[p].x - ref[p].x, img[p].y - ref[p].y, img[p].z - ref[p].z };
+		double r[3] = { ref[p].x, ref[p].y, ref[p].z };
+		for (int c = 0; c < 3; c++) {
+			m.rmse += d[c] * d[c];
+			m.relmse += d[c] * d[c] / (r[c] * r[c] + 0.01);
+		}
+	}
+	m.rmse = sqrt(m.rmse / (3.0 * w * h));
+	m.relmse /= 3.0 * w * h;
+
+	const double kernel[3] = { 0.25, 0.5, 0.25 };
+	const double maxDistance = hyab(displayLab(Color(0, 1, 0)), displayLab(Color(0, 0, 1)));
+	double flip = 0;
+	#pragma omp parallel for reduction(+:flip)
+	for (int y = 0; y < h; y++)
+		for (int x = 0; x < w; x++) {
+			Color a = Color(), b = Color();
+			for (int j = -1; j <= 1; j++)
+				for (int i = -1; i <= 1; i++) {
+					int sx = std::min(std::max(x + i, 0), w - 1), sy = std::min(std::max(y + j, 0), h - 1);
+					double k = kernel[i + 1] * kernel[j + 1];
+					a = a + Color(clamp(img[sy * w + sx].x), clamp(img[sy * w + sx].y), clamp(img[sy * w + sx].z)) * k;
+					b = b + Color(clamp(ref[sy * w + sx].x), clamp(ref[sy * w + sx].y), clamp(ref[sy * w + sx].z)) * k;
+				}
+			flip += std::min(1.0, hyab(displayLab(a), displayLab(b)) / maxDistance);
+		}
+	m.flip = flip / (w * h);
+	return m;
+}
+
+// Renderiza de forma progresiva (1 spp por pase) y cada `interval` segundos
+// escribe en stdout un renglón CSV con el error contra la referencia. La
+// referencia se lee de referencePath si se generó con la misma escena
+// (scenePath, NULL para la Cornell Box) y referenceSpp; si no, se renderiza
+// con referenceSpp muestras y se guarda ahí.
+int runConvergence(const View &view, const char *scenePath, const char *referencePath, int referenceSpp,
+                   double interval, double budget) {
+	int w = view.w, h = view.h;
+	std::vector<Color> reference;
+
+	char tag[64];
+	snprintf(tag, sizeof(tag), "rt ref-spp=%d escena=", referenceSpp);
+	std::string referenceTag = tag + (scenePath ? absolutePath(scenePath) : std::string("cornell"));
+
+	if (!referencePath || !readPFM(referencePath, reference, w, h, referenceTag)) {
+		if (referencePath && access(referencePath, F_OK) == 0)
+			fprintf(stderr, "%s es de otra escena, resolución o ref-spp; se reemplaza\n", referencePath);
+		fprintf(stderr, "renderizando referencia con %d spp...\n", referenceSpp);
+		SamplingMethod method = samplingMethod;
+		samplingMethod = COSINE_HEMISPHERE;
+		reference.assign(w * h, Color());
+		for (int s = 0; s < referenceSpp; s++) {
+			renderPass(view, reference);
+			fprintf(stderr, "\r%5.2f%%", 100. * (s + 1) / referenceSpp);
+		}
+		fprintf(stderr, "\n");
+		for (int p = 0; p < w * h; p++)
+			reference[p] = reference[p] * (1.0 / referenceSpp);
+		if (referencePath && !writePFM(referencePath, reference, w, h, referenceTag))
+			fprintf(stderr, "no se pudo guardar la referencia en %s\n", referencePath);
+		samplingMethod = method;
+	}
+
+	printf("method,spp,time_s,rays,rmse,relmse,flip\n");
+
+	std::vector<Color> sums(w * h, Color()), estimate(w * h);
+	unsigned long long rays = 0;
+	double elapsed = 0, nextReport = interval;
+	int spp = 0;
+
+	while (elapsed < budget) {
+		double start = omp_get_wtime();
+		rays += renderPass(view, sums);
+		elapsed += omp_get_wtime() - start;
+		spp++;
+
+		if (elapsed < nextReport && elapsed < budget)
+			continue;
+
+		// El cálculo del error no cuenta como tiempo de render
+		for (int p = 0; p < w * h; p++)
+			estimate[p] = sums[p] * (1.0 / spp);
+		ErrorMetrics m = computeErrors(estimate, reference, w, h);
+		printf("%s,%d,%.3f,%llu,%.6g,%.6g,%.6g\n", SAMPLING_NAMES[samplingMethod], spp, elapsed, rays,
+			m.rmse, m.relmse, m.flip);
+		fflush(stdout);
+		fprintf(stderr, "\r%s: %.1f s, %d spp", SAMPLING_NAMES[samplingMethod], elapsed, spp);
+		while (nextReport <= elapsed) nextReport += interval;
+	}
+	fprintf(stderr, "\n");
+	return 0;
+}
+
+// ---------------------------------------------------------------------------
+// Comparación entre la escena compilada y la genérica
+// ---------------------------------------------------------------------------
+
+// Mide intersect() contra bakedIntersect() sobre los mismos rayos y un render
+// completo con shade() contra bakedShade() usando la misma semilla, y verifica
+// que los resultados sean idénticos.
+int runBakedBenchmark(const View &view, int spp) {
+	const int repetitions = 5;
+
+	// Rayos de cámara y rayos desde puntos aleatorios dentro de la caja
+	const int count = 2000000;
+	std::vector<Ray> rays;
+	rays.reserve(count);
+	rng.seed(1);
+	for (int i = 0; i < count; i++) {
+		if (i % 2 == 0)
+			rays.push_back(view.primaryRay(int(uniform_random() * view.w), int(uniform_random() * view.h)));
+		else
+			rays.push_back(Ray(Point(98 * uniform_random() - 49, 81.6 * uniform_random() - 40.8,
+			                         81.6 * uniform_random() - 81.6), uniform_sphere_sample()));
+	}
+
+	std::vector<double> tGeneric(count), tBaked(count);
+	std::vector<int> idGeneric(count, -1), idBaked(count, -1);
+
+	// Cada repetición alterna cuál versión corre primero y se toma el mínimo,
+	// para que ninguna pague sola el arranque en frío
+	double times[2] = { 1e30, 1e30 };
+	for (int rep = 0; rep < 2 * repetitions; rep++) {
+		int version = (rep + rep / 2) % 2;   // 0, 1, 1, 0, 0, 1, ...
+		double start = omp_get_wtime();
+		if (version == 0) {
+			for (int i = 0; i < count; i++)
+				if (!intersect(rays[i], tGeneric[i], idGeneric[i])) idGeneric[i] = -1;
+		} else {
+			for (int i = 0; i < count; i++)
+				if (!bakedIntersect(rays[i], tBaked[i], idBaked[i])) idBaked[i] = -1;
+		}
+		times[version] = std::min(times[version], omp_get_wtime() - start);
+	}
+
+	int mismatches = 0;
+	for (int i = 0; i < count; i++)
+		if (idGeneric[i] != idBaked[i] || (idGeneric[i] >= 0 && tGeneric[i] != tBaked[i]))
+			mismatches++;
+
+	printf("intersección: %d rayos, genérica %.3f s, compilada %.3f s, %.2fx, %d diferencias (mínimo de %d)\n",
+		count, times[0], times[1], times[0] / times[1], mismatches, repetitions);
+
+	// Render en un solo hilo con la misma semilla para que ambas versiones
+	// consuman la misma secuencia de números aleatorios
+	int w = view.w, h = view.h;
+	std::vector<Color> images[2];
+	times[0] = times[1] = 1e30;
+	for (int rep = 0; rep < 2 * repetitions; rep++) {
+		int version = (rep + rep / 2) % 2;
+		std::vector<Color> &img = images[version];
+		img.assign(w * h, Color());
+		rng.seed(7);
+		double start = omp_get_wtime();
+		for (int y = 0; y < h; y++)
+			for (int x = 0; x < w; x++)
+				for (int s = 0; s < spp; s++)
+					img[y * w + x] = img[y * w + x] +
+						(version == 0 ? shade(view.primaryRay(x, y)) : bakedShade(view.primaryRay(x, y)));
+		times[version] = std::min(times[version], omp_get_wtime() - start);
+	}
+
+	double maxDiff = 0;
+	for (int p = 0; p < w * h; p++)
+		maxDiff = std::max(maxDiff, std::max(fabs(images[0][p].x - images[1][p].x),
+			std::max(fabs(images[0][p].y - images[1][p].y), fabs(images[0][p].z - images[1][p].z))));
+
+	printf("render %dx%d, %d spp: genérico %.3f s, compilado %.3f s, %.2fx, diferencia máxima %g (mínimo de %d)\n",
+		w, h, spp, times[0], times[1], times[0] / times[1], maxDiff, repetitions);
+
+	return mismatches == 0 && maxDiff == 0 ? 0 : 1;
+}
+
+// ---------------------------------------------------------------------------
+// Secuencias animadas con reutilización temporal de muestras
+// ---------------------------------------------------------------------------
+
+// Máximo de muestras heredadas del cuadro anterior, en múltiplos de las spp
+// de un cuadro. Limita el rastro que deja la iluminación indirecta cuando algo
+// se mueve (una sombra que cambia no se detecta con profundidad ni normal).
+const int TEMPORAL_MAX_HISTORY = 4;
+// Tolerancias para aceptar la muestra reproyectada
+const double TEMPORAL_DEPTH_TOLERANCE = 0.02;   // diferencia relativa de profundidad
+const double TEMPORAL_NORMAL_TOLERANCE = 0.9;   // coseno mínimo entre normales
+
+// Cuadro clave: valor de una esfera o de la cámara en un cuadro
+struct Keyframe {
+	int frame;
+	Vector a, b;   // posición (esfera) u origen y dirección (cámara)
+};
+
+// Animación leída de un archivo de texto:
+//   frames N
+//   sphere <cuadro> <índice> x y z
+//   camera <cuadro> ox oy oz dx dy dz
+// Entre cuadros clave los valores se interpolan linealmente.
+struct Animation {
+	int frames;
+	std::map<int, std::vector<Keyframe> > spheres;
+	std::vector<Keyframe> camera;
+};
+
+// View toma el eje x como horizontal: la dirección debe salirse de él
+bool cameraDirectionValid(const Vector &d) {
+	return d.y * d.y + d.z * d.z > 1e-12 * d.dot(d) && d.dot(d) > 0;
+}
+
+bool loadAnimation(const char *path, int sceneSize, Animation &anim, std::string &error) {
+	FILE *f = fopen(path, "r");
+	if (!f) {
+		error = std::string("no se pudo abrir ") + path;
+		return false;
+	}
+
+	anim.frames = 0;
+	char line[512];
+	int lineNumber = 0;
+	while (fgets(line, sizeof(line), f)) {
+		lineNumber++;
+		char kind[16];
+		double v[6];
+		int frame, index;
+		if (sscanf(line, " %15s", kind) != 1 || kind[0] == '#')
+			continue;
+		if (strcmp(kind, "frames") == 0 && sscanf(line, " frames %d", &anim.frames) == 1)
+			continue;
+		if (strcmp(kind, "sphere") == 0 &&
+		    sscanf(line, " sphere %d %d %lf %lf %lf", &frame, &index, &v[0], &v[1], &v[2]) == 5 &&
+		    frame >= 0 && index >= 0 && index < sceneSize) {
+			Keyframe k = { frame, Vector(v[0], v[1], v[2]), Vector() };
+			anim.spheres[index].push_back(k);
+		} else if (strcmp(kind, "camera") == 0 &&
+		           sscanf(line, " camera %d %lf %lf %lf %lf %lf %lf", &frame, &v[0], &v[1], &v[2], &v[3], &v[4], &v[5]) == 7 &&
+		           frame >= 0) {
+			// El eje horizontal de la imagen es el eje x (ver View), así que la
+			// cámara necesita una componente en y o z
+			if (!cameraDirectionValid(Vector(v[3], v[4], v[5]))) {
+				error = std::string(path) + ": renglón " + std::to_string(lineNumber) +
+				        ": la dirección de la cámara es cero o paralela al eje x";
+				fclose(f);
+				return false;
+			}
+			Keyframe k = { frame, Vector(v[0], v[1], v[2]), Vector(v[3], v[4], v[5]).normalize() };
+			anim.camera.push_back(k);
+		} else {
+			error = std::string(path) + ": renglón " + std::to_string(lineNumber) + " inválido";
+			fclose(f);
+			return false;
+		}
+	}
+	fclose(f);
+
+	// Ordenar los cuadros clave y deducir el número de cuadros si no se dio
+	std::map<int, std::vector<Keyframe> >::iterator it;
+	for (it = anim.spheres.begin(); it != anim.spheres.end(); ++it) {
+		std::sort(it->second.begin(), it->second.end(), [](const Keyframe &a, const Keyframe &b) { return a.frame < b.frame; });
+		anim.frames = std::max(anim.frames, it->second.back().frame + 1);
+	}
+	std::sort(anim.camera.begin(), anim.camera.end(), [](const Keyframe &a, const Keyframe &b) { return a.frame < b.frame; });
+	if (!anim.camera.empty())
+		anim.frames = std::max(anim.frames, anim.camera.back().frame + 1);
+
+	if (anim.frames <= 0) {
+		error = std::string(path) + ": la animación no tiene cuadros";
+		return false;
+	}
+	return true;
+}
+
+// Interpola dos direcciones unitarias sobre la esfera (slerp), así la cámara
+// gira a velocidad constante y nunca pasa por el vector cero. Si son opuestas
+// gira alrededor del eje x de la imagen, por el plano perpendicular a él.
+Vector slerpDirection(const Vector &d0, const Vector &d1, double u) {
+	double c = std::max(-1.0, std::min(1.0, d0.dot(d1)));
+	double theta = acos(c);
+	if (theta < 1e-6)
+		return Vector(d0 * (1 - u) + d1 * u).normalize();
+	if (M_PI - theta < 1e-6) {
+		Vector axis(1, 0, 0), d = d0;
+		Vector p = Vector(axis % d).normalize();
+		return d0 * cos(u * M_PI) + p * sin(u * M_PI);
+	}
+	return (d0 * sin((1 - u) * theta) + d1 * sin(u * theta)) * (1.0 / sin(theta));
+}
+
+// Interpola los cuadros clave en el cuadro dado: la posición linealmente y la
+// dirección (solo en la cámara; en las esferas b es cero) con slerpDirection
+Keyframe interpolate(const std::vector<Keyframe> &keys, int frame) {
+	if (frame <= keys.front().frame) return keys.front();
+	if (frame >= keys.back().frame) return keys.back();
+	size_t i = 1;
+	while (keys[i].frame < frame) i++;
+	const Keyframe &k0 = keys[i - 1], &k1 = keys[i];
+	double u = double(frame - k0.frame) / (k1.frame - k0.frame);
+	Vector b = k0.b.dot(k0.b) > 0 ? slerpDirection(k0.b, k1.b, u) : Vector();
+	Keyframe k = { frame, k0.a * (1 - u) + k1.a * u, b };
+	return k;
+}
+
+// Proyecta el punto q a coordenadas de pixel de la vista (inverso de
+// primaryRay). Resuelve q - o = s (cx·α + cy·β + d) con la regla de Cramer.
+bool projectToPixel(const View &view, const Point &q, int &px, int &py) {
+	Vector v = q - view.camera.o;
+	Vector cx = view.cx, cy = view.cy, d = view.camera.d;
+	double det = cx.dot(cy % d);
+	if (fabs(det) < 1e-12) return false;
+	double alpha = v.dot(cy % d) / det;
+	double beta = cx.dot(v % d) / det;
+	double s = cx.dot(cy % v) / det;
+	if (s <= 0) return false;
+
+	px = int(floor((alpha / s + .5) * view.w + .5));
+	py = int(floor((beta / s + .5) * view.h + .5));
+	return px >= 0 && px < view.w && py >= 0 && py < view.h;
+}
+
+// Historia de un cuadro: radiancia acumulada y datos del primer impacto de
+// cada pixel, indexados por y * w + x (sin invertir el renglón)
+struct FrameHistory {
+	std::vector<Color> sum;
+	std::vector<float> count;
+	std::vector<float> depth;
+	std::vector<Vector> normal;
+	std::vector<int> id;
+
+	void resize(int n) {
+		sum.assign(n, Color()); count.assign(n, 0); depth.assign(n, 0);
+		normal.assign(n, Vector()); id.assign(n, -1);
+	}
+};
+
+// Nombre de archivo de cada cuadro: prefijo + número + sufijo. Se arma a
+// partir del patrón de -o sin usarlo nunca como formato de printf.
+struct FramePattern {
+	std::string prefix, suffix;
+	int width;       // ancho mínimo del número
+	bool zeroPad;    // rellenar con ceros
+};
+
+// Acepta exactamente una conversión entera (%d, %4d, %04d; %% es un % literal).
+// Si el patrón no tiene ninguna, el número se agrega antes de la extensión:
+// cuadro.ppm -> cuadro-0000.ppm.
+bool parseFramePattern(const char *pattern, FramePattern &fp, std::string &error) {
+	std::string text[2];
+	int conversions = 0;
+	fp.width = 0;
+	fp.zeroPad = false;
+
+	for (const char *c = pattern; *c; c++) {
+		if (*c != '%') {
+			text[conversions > 0].push_back(*c);
+			continue;
+		}
+		if (c[1] == '%') {
+			text[conversions > 0].push_back('%');
+			c++;
+			continue;
+		}
+		const char *spec = c + 1;
+		bool zero = *spec == '0';
+		if (zero) spec++;
+		int width = 0;
+		while (*spec >= '0' && *spec <= '9' && width < 100)
+			width = width * 10 + (*spec++ - '0');
+		if (*spec != 'd' || ++conversions > 1) {
+			error = std::string("patrón de salida inválido: ") + pattern +
+			        " (se espera una sola conversión %d, por ejemplo frame-%04d.ppm)";
+			return false;
+		}
+		fp.zeroPad = zero;
+		fp.width = width;
+		c = spec;
+	}
+
+	if (conversions == 1) {
+		fp.prefix = text[0];
+		fp.suffix = text[1];
+		return true;
+	}
+
+	// Sin conversión: insertar -%04d antes de la extensión del nombre
+	size_t slash = text[0].rfind('/');
+	size_t dot = text[0].rfind('.');
+	if (dot == std::string::npos || (slash != std::string::npos && dot < slash) || dot == slash + 1)
+		dot = text[0].size();
+	fp.prefix = text[0].substr(0, dot) + "-";
+	fp.suffix = text[0].substr(dot);
+	fp.width = 4;
+	fp.zeroPad = true;
+	return true;
+}
+
+std::string frameFileName(const FramePattern &fp, int frame) {
+	char number[32];
+	snprintf(number, sizeof(number), fp.zeroPad ? "%0*d" : "%*d", fp.width, frame);
+	return fp.prefix + number + fp.suffix;
+}
+
+// Renderiza la animación cuadro por cuadro sobre una copia de la escena activa.
+// Entre cuadros solo se actualizan las posiciones de las esferas (no se vuelve
+// a cargar ni a reservar la escena) y la radiancia del cuadro anterior se
+// reproyecta con el movimiento de cada esfera y de la cámara; se descarta si
+// el pixel ve otra esfera o si la profundidad o la normal no coinciden.
+int runSequence(const char *path, const View &base, int spp, const char *pattern) {
+	Scene animated = *scene;
+	Animation anim;
+	FramePattern outputPattern;
+	std::string error;
+	if (!parseFramePattern(pattern, outputPattern, error) || !loadAnimation(path, animated.spheres.size(), anim, error)) {
+		fprintf(stderr, "%s\n", error.c_str());
+		return 1;
+	}
+
+	const Scene *previousScene = scene;
+	scene = &animated;
+
+	int w = base.w, h = base.h;
+	FrameHistory current, previous;
+	current.resize(w * h);
+	previous.resize(w * h);
+	std::vector<Point> positions(animated.spheres.size()), previousPositions;
+	View previousView = base;
+	Color *pixelColors = new Color[w * h];
+	double totalTime = 0;
+
+	for (int frame = 0; frame < anim.frames; frame++) {
+		// Actualizar la escena y la cámara en su lugar
+		std::map<int, std::vector<Keyframe> >::iterator it;
+		for (it = anim.spheres.begin(); it != anim.spheres.end(); ++it)
+			animated.spheres[it->first].p = interpolate(it->second, frame).a;
+		for (size_t i = 0; i < positions.size(); i++)
+			positions[i] = animated.spheres[i].p;
+		View view = base;
+		if (!anim.camera.empty()) {
+			Keyframe k = interpolate(anim.camera, frame);
+			// Los cuadros clave son válidos, pero el giro entre dos de ellos
+			// puede cruzar el eje x
+			if (!cameraDirectionValid(k.b)) {
+				fprintf(stderr, "cuadro %d: la cámara queda paralela al eje x\n", frame);
+				delete[] pixelColors;
+				scene = previousScene;
+				return 1;
+			}
+			view = View(w, h, Ray(k.a, Vector(k.b).normalize()));
+		}
+
+		double start = omp_get_wtime();
+		long reused = 0;
+
+		#pragma omp parallel for schedule(dynamic, 1) reduction(+:reused)
+		for (int y = 0; y < h; y++) {
+			for (int x = 0; x < w; x++) {
+				int i = y * w + x;
+				Ray primary = view.primaryRay(x, y);
+				Color sum = Color();
+				float count = 0;
+
+				double t;
+				int id = -1;
+				if (intersect(primary, t, id)) {
+					Point hit = primary.o + primary.d * t;
+					Vector n = (hit - animated.spheres[id].p).normalize();
+					current.depth[i] = t;
+					current.normal[i] = n;
+
+					// Posición del mismo punto en el cuadro anterior
+					int px, py;
+					if (frame > 0 && projectToPixel(previousView, hit - (positions[id] - previousPositions[id]), px, py)) {
+						int j = py * w + px;
+						Point previousHit = hit - (positions[id] - previousPositions[id]);
+						Vector toPrevious = previousHit - previousView.camera.o;
+						double expected = sqrt(toPrevious.dot(toPrevious));
+						if (previous.id[j] == id && previous.count[j] > 0 &&
+						    fabs(previous.depth[j] - expected) <= TEMPORAL_DEPTH_TOLERANCE * expected &&
+						    previous.normal[j].dot(n) >= TEMPORAL_NORMAL_TOLERANCE) {
+							double keep = std::min(1.0, double(TEMPORAL_MAX_HISTORY * spp) / previous.count[j]);
+							sum = previous.sum[j] * keep;
+							count = previous.count[j] * keep;
+							reused++;
+						}
+					}
+				}
+				current.id[i] = id;
+
+				for (int s = 0; s < spp; s++)
+					sum = sum + shade(primary);
+				current.sum[i] = sum;
+				current.count[i] = count + spp;
+
+				Color c = sum * (1.0 / current.count[i]);
+				pixelColors[(h - y - 1) * w + x] = Color(clamp(c.x), clamp(c.y), clamp(c.z));
+			}
+		}
+
+		double elapsed = omp_get_wtime() - start;
+		totalTime += elapsed;
+
+		std::string output = frameFileName(outputPattern, frame);
+		if (!writePPM(output.c_str(), pixelColors, w, h)) {
+			delete[] pixelColors;
+			scene = previousScene;
+			return 1;
+		}
+		fprintf(stderr, "cuadro %d/%d: %.2f s, %.1f%% de pixeles con historia -> %s\n", frame + 1, anim.frames,
+			elapsed, 100.0 * reused / (w * h), output.c_str());
+
+		std::swap(current, previous);
+		previousPositions = positions;
+		previousView = view;
+	}
+
+	fprintf(stderr, "%d cuadros en %.2f s\n", anim.frames, totalTime);
+	delete[] pixelColors;
+	scene = previousScene;
+	return 0;
+}
+
+// ---------------------------------------------------------------------------
+// Framebuffer por tiles: precisión reducida, memoria local y modo fuera de núcleo
+// ---------------------------------------------------------------------------
+
+const int FB_TILE = 64;   // lado de un tile en pixeles
+
+// Conversión float <-> half (IEEE 754 binario16), redondeo al más cercano
+inline uint16_t floatToHalf(float f) {
+	uint32_t x;
+	memcpy(&x, &f, sizeof(x));
+	uint32_t sign = (x >> 16) & 0x8000;
+	int exp = int((x >> 23) & 0xff) - 127 + 15;
+	uint32_t mant = x & 0x7fffff;
+
+	if (exp <= 0) {            // subnormal o cero
+		if (exp < -10) return sign;
+		mant |= 0x800000;
+		int shift = 14 - exp;
+		uint32_t h = mant >> shift;
+		if ((mant >> (shift - 1)) & 1) h++;
+		return sign | h;
+	}
+	if (exp >= 31) return sign | 0x7c00;   // infinito
+	uint32_t h = sign | (exp << 10) | (mant >> 13);
+	if (mant & 0x1000) h++;   // el acarreo hacia el exponente también es correcto
+	return h;
+}
+
+inline float halfToFloat(uint16_t h) {
+	uint32_t sign = uint32_t(h & 0x8000) << 16;
+	int exp = (h >> 10) & 0x1f;
+	uint32_t mant = h & 0x3ff;
+	if (exp == 0) {
+		float f = ldexpf(float(mant), -24);
+		return sign ? -f : f;
+	}
+	uint32_t x = exp == 31 ? sign | 0x7f800000 | (mant << 13)
+	                       : sign | uint32_t(exp - 15 + 127) << 23 | (mant << 13);
+	float f;
+	memcpy(&f, &x, sizeof(f));
+	return f;
+}
+
+// Imagen guardada en tiles de FB_TILE x FB_TILE en float (12 bytes por pixel)
+// o half (6 bytes por pixel) en vez de Color (24 bytes por pixel).
+//  - En memoria, cada tile se reserva en storeTile, es decir, en el hilo que
+//    lo renderizó: la política de primer toque lo deja en el nodo NUMA de ese
+//    hilo (ver pinThreads).
+//  - Fuera de núcleo, los tiles viven en un archivo temporal mapeado con
+//    mmap; al terminar un tile sus páginas se liberan, así que la memoria
+//    residente no crece con la resolución.
+class TiledFramebuffer {
+public:
+	TiledFramebuffer(int w_, int h_, bool half_, const char *spillPath)
+		: w(w_), h(h_), half(half_), mapped(NULL), mappedSize(0), fd(-1), valid(true) {
+		tilesX = (w + FB_TILE - 1) / FB_TILE;
+		tilesY = (h + FB_TILE - 1) / FB_TILE;
+
+		// Cada tile ocupa un número entero de páginas para poder liberarlo solo
+		size_t page = sysconf(_SC_PAGESIZE);
+		tileBytes = (size_t)FB_TILE * FB_TILE * 3 * (half ? sizeof(uint16_t) : sizeof(float));
+		tileBytes = (tileBytes + page - 1) / page * page;
+
+		if (!spillPath) {
+			tiles.assign(tileCount(), NULL);
+			return;
+		}
+
+		mappedSize = tileBytes * tileCount();
+		// El archivo es temporal: no se sobrescribe uno existente y se borra
+		// del directorio en cuanto se abre, el espacio se libera al cerrarlo
+		fd = open(spillPath, O_RDWR | O_CREAT | O_EXCL, 0600);
+		if (fd >= 0) unlink(spillPath);
+		if (fd < 0 || ftruncate(fd, mappedSize) < 0) {
+			fprintf(stderr, "no se pudo crear %s: %s\n", spillPath, strerror(errno));
+			valid = false;
+			return;
+		}
+		void *p = mmap(NULL, mappedSize, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+		if (p == MAP_FAILED) {
+			fprintf(stderr, "no se pudo mapear %s: %s\n", spillPath, strerror(errno));
+			valid = false;
+			return;
+		}
+		mapped = (char *)p;
+	}
+
+	~TiledFramebuffer() {
+		for (size_t i = 0; i < tiles.size(); i++) free(tiles[i]);
+		if (mapped) munmap(mapped, mappedSize);
+		if (fd >= 0) close(fd);
+	}
+
+	bool ok() const { return valid; }
+	int tileCount() const { return tilesX * tilesY; }
+
+	// Pixeles [x0, x1) x [y0, y1) del tile; y = 0 es el renglón superior,
+	// igual que en pixelColors
+	void tileBounds(int tile, int &x0, int &y0, int &x1, int &y1) const {
+		x0 = (tile % tilesX) * FB_TILE;
+		y0 = (tile / tilesX) * FB_TILE;
+		x1 = std::min(x0 + FB_TILE, w);
+		y1 = std::min(y0 + FB_TILE, h);
+	}
+
+	// Guarda un tile terminado; pixels tiene FB_TILE x FB_TILE colores.
+	// Debe llamarse desde el hilo que renderizó el tile.
+	// Regresa false si no hubo memoria para el tile
+	bool storeTile(int tile, const Color *pixels) {
+		char *data;
+		if (mapped)
+			data = mapped + tileBytes * tile;
+		else {
+			if (!tiles[tile]) tiles[tile] = (char *)malloc(tileBytes);
+			data = tiles[tile];
+			if (!data) return false;
+		}
+
+		for (int i = 0; i < FB_TILE * FB_TILE; i++) {
+			float c[3] = { float(pixels[i].x), float(pixels[i].y), float(pixels[i].z) };
+			for (int k = 0; k < 3; k++) {
+				if (half) ((uint16_t *)data)[3 * i + k] = floatToHalf(c[k]);
+				else      ((float *)data)[3 * i + k] = c[k];
+			}
+		}
+
+		// Fuera de núcleo: escribir el tile al archivo y soltar sus páginas
+		if (mapped) {
+			msync(data, tileBytes, MS_ASYNC);
+			madvise(data, tileBytes, MADV_DONTNEED);
+		}
+		return true;
+	}
+
+	Color get(int x, int y) const {
+		int tile = (y / FB_TILE) * tilesX + x / FB_TILE;
+		const char *data = mapped ? mapped + tileBytes * tile : tiles[tile];
+		if (!data) return Color();
+		int i = 3 * ((y % FB_TILE) * FB_TILE + x % FB_TILE);
+		if (half) {
+			const uint16_t *p = (const uint16_t *)data;
+			return Color(halfToFloat(p[i]), halfToFloat(p[i + 1]), halfToFloat(p[i + 2]));
+		}
+		const float *p = (const float *)data;
+		return Color(p[i], p[i + 1], p[i + 2]);
+	}
+
+	// Fuera de núcleo: suelta las páginas de una fila de tiles ya leída
+	void releaseTileRow(int ty) {
+		if (mapped)
+			madvise(mapped + tileBytes * ty * tilesX, tileBytes * tilesX, MADV_DONTNEED);
+	}
+
+private:
+	int w, h, tilesX, tilesY;
+	bool half;
+	size_t tileBytes;
+	std::vector<char *> tiles;   // tiles en memoria (NULL si no se han renderizado)
+	char *mapped;                // tiles fuera de núcleo
+	size_t mappedSize;
+	int fd;
+	bool valid;
+};
+
+// Escribe el framebuffer en formato ppm renglón por renglón
+bool writePPM(const char *path, TiledFramebuffer &framebuffer, int w, int h) {
+	FILE *f = fopen(path, "w");
+	if (!f) {
+		fprintf(stderr, "no se pudo abrir %s: %s\n", path, strerror(errno));
+		return false;
+	}
+	fprintf(f, "P3\n%d %d\n%d\n", w, h, 255);
+	for (int y = 0; y < h; y++) {
+		for (int x = 0; x < w; x++) {
+			Color c = framebuffer.get(x, y);
+			fprintf(f,"%d %d %d ", toDisplayValue(c.x), toDisplayValue(c.y), toDisplayValue(c.z));
+		}
+		if (y % FB_TILE == FB_TILE - 1 || y == h - 1)
+			framebuffer.releaseTileRow(y / FB_TILE);
+	}
+	if (ferror(f) | fclose(f)) {
+		fprintf(stderr, "no se pudo escribir %s\n", path);
+		return false;
+	}
+	return true;
+}
+
+// Fija cada hilo de OpenMP a un CPU distinto de los permitidos al proceso.
+// libgomp reutiliza los mismos hilos en las regiones paralelas siguientes, así
+// que un hilo no migra de socket y la memoria que toca primero queda local.
+void pinThreads() {
+	cpu_set_t allowed;
+	if (sched_getaffinity(0, sizeof(allowed), &allowed) != 0)
+		return;
+	std::vector<int> cpus;
+	for (int c = 0; c < CPU_SETSIZE; c++)
+		if (CPU_ISSET(c, &allowed)) cpus.push_back(c);
+
+	#pragma omp parallel
+	{
+		cpu_set_t one;
+		CPU_ZERO(&one);
+		CPU_SET(cpus[omp_get_thread_num() % cpus.size()], &one);
+		sched_setaffinity(0, sizeof(one), &one);
+	}
+}
+
+// Opciones de línea de comandos. Los valores por defecto son las constantes
+// de configuración, así que ./rt sin argumentos se comporta como siempre.
+struct Options {
+	int w, h;            // --size WxH
+	int spp;             // --spp N
+	const char *output;  // -o archivo.ppm
+	const char *coordinator; // --coordinator <socket>
+	const char *worker;      // --worker <socket>
+	double unitTimeout;      // --unit-timeout segundos (solo con --coordinator)
+	const char *daemon;      // --daemon <socket>
+	const char *connect;     // --connect <socket>: cliente del servicio
+	const char *scene;       // --scene archivo (con --connect o en los modos locales)
+	const char *camera;      // --camera ox,oy,oz,dx,dy,dz (solo con --connect)
+	int priority;            // --priority N (solo con --connect)
+	std::string command;     // --cancel ID, --status o --shutdown
+	bool converge;           // --converge: curva de error en CSV por stdout
+	const char *reference;   // --reference archivo.pfm
+	int referenceSpp;        // --ref-spp N
+	double interval;         // --interval segundos entre mediciones
+	double budget;           // --time segundos totales
+	bool baked;              // --baked: usar la Cornell Box compilada
+	bool benchBaked;         // --bench-baked: comparar escena compilada y genérica
+	const char *sequence;    // --sequence animación.txt; -o es un patrón como frame-%04d.ppm
+	const char *framebuffer; // --framebuffer half|float (float si se omite)
+	const char *outOfCore;   // --out-of-core archivo: tiles en un archivo mapeado
+	bool pin;                // --pin: fijar los hilos a CPUs
+	bool photons;            // --photons: estimar la radiancia con el mapa de fotones
+	int photonPasses;        // --photon-passes N (solo con --photons)
+
+	Options() : w(1024), h(768), spp(SAMPLES_PER_PIXEL), output("image.ppm"),
+	            coordinator(NULL), worker(NULL), unitTimeout(DIST_UNIT_TIMEOUT), daemon(NULL), connect(NULL),
+	            scene(NULL), camera(NULL), priority(0), converge(false),
+	            reference(NULL), referenceSpp(4096), interval(1.0), budget(30.0),
+	            baked(false), benchBaked(false), sequence(NULL), framebuffer(NULL),
+	            outOfCore(NULL), pin(false), photons(false), photonPasses(1) {}
+};
+
+bool parseOptions(int argc, char *argv[], Options &opt) {
+	for (int i = 1; i < argc; i++) {
+		bool hasValue = i + 1 < argc;
+		if (strcmp(argv[i], "--spp") == 0 && hasValue)
+			opt.spp = atoi(argv[++i]);
+		else if (strcmp(argv[i], "--size") == 0 && hasValue) {
+			if (sscanf(argv[++i], "%dx%d", &opt.w, &opt.h) != 2) return false;
+		}
+		else if (strcmp(argv[i], "-o") == 0 && hasValue)
+			opt.output = argv[++i];
+		else if (strcmp(argv[i], "--coordinator") == 0 && hasValue)
+			opt.coordinator = argv[++i];
+		else if (strcmp(argv[i], "--worker") == 0 && hasValue)
+			opt.worker = argv[++i];
+		else if (strcmp(argv[i], "--unit-timeout") == 0 && hasValue)
+			opt.unitTimeout = atof(argv[++i]);
+		else if (strcmp(argv[i], "--daemon") == 0 && hasValue)
+			opt.daemon = argv[++i];
+		else if (strcmp(argv[i], "--connect") == 0 && hasValue)
+			opt.connect = argv[++i];
+		else if (strcmp(argv[i], "--scene") == 0 && hasValue)
+			opt.scene = argv[++i];
+		else if (strcmp(argv[i], "--camera") == 0 && hasValue)
+			opt.camera = argv[++i];
+		else if (strcmp(argv[i], "--priority") == 0 && hasValue)
+			opt.priority = atoi(argv[++i]);
+		else if (strcmp(argv[i], "--cancel") == 0 && hasValue)
+			opt.command = std::string("CANCEL ") + argv[++i];
+		else if (strcmp(argv[i], "--status") == 0)
+			opt.command = "STATUS";
+		else if (strcmp(argv[i], "--shutdown") == 0)
+			opt.command = "SHUTDOWN";
+		else if (strcmp(argv[i], "--sampling") == 0 && hasValue) {
+			if (!parseSamplingMethod(argv[++i], samplingMethod)) return false;
+		}
+		else if (strcmp(argv[i], "--framebuffer") == 0 && hasValue) {
+			opt.framebuffer = argv[++i];
+			if (strcmp(opt.framebuffer, "half") != 0 && strcmp(opt.framebuffer, "float") != 0) return false;
+		}
+		else if (strcmp(argv[i], "--out-of-core") == 0 && hasValue)
+			opt.outOfCore = argv[++i];
+		else if (strcmp(argv[i], "--pin") == 0)
+			opt.pin = true;
+		else if (strcmp(argv[i], "--photons") == 0)
+			opt.photons = true;
+		else if (strcmp(argv[i], "--photon-passes") == 0 && hasValue)
+			opt.photonPasses = atoi(argv[++i]);
+		else if (strcmp(argv[i], "--sequence") == 0 && hasValue)
+			opt.sequence = argv[++i];
+		else if (strcmp(argv[i], "--baked") == 0)
+			opt.baked = true;
+		else if (strcmp(argv[i], "--bench-baked") == 0)
+			opt.benchBaked = true;
+		else if (strcmp(argv[i], "--converge") == 0)
+			opt.converge = true;
+		else if (strcmp(argv[i], "--reference") == 0 && hasValue)
+			opt.reference = argv[++i];
+		else if (strcmp(argv[i], "--ref-spp") == 0 && hasValue)
+			opt.referenceSpp = atoi(argv[++i]);
+		else if (strcmp(argv[i], "--interval") == 0 && hasValue)
+			opt.interval = atof(argv[++i]);
+		else if (strcmp(argv[i], "--time") == 0 && hasValue)
+			opt.budget = atof(argv[++i]);
+		else
+			return false;
+	}
+	return opt.w > 0 && opt.h > 0 && opt.spp > 0 && opt.referenceSpp > 0 && opt.interval > 0 && opt.budget > 0 &&
+	       opt.unitTimeout > 0 && opt.photonPasses > 0;
+}
+
+// Rechaza opciones que el modo elegido no usaría
+bool checkOptionModes(const Options &opt) {
+	// Solo el render normal guarda la imagen en un TiledFramebuffer
+	bool otherMode = opt.coordinator || opt.worker || opt.daemon || opt.connect ||
+	                 opt.converge || opt.sequence || opt.benchBaked;
+	bool tiledRender = !otherMode && !opt.photons;
+	const char *unused = NULL;
+	if (!opt.connect && opt.camera)
+		unused = "--camera";
+	else if (!opt.connect && opt.priority != 0)
+		unused = "--priority";
+	else if ((opt.coordinator || opt.worker || opt.daemon) && opt.scene)
+		unused = "--scene";
+	// El trabajador recibe resolución, spp y método en cada unidad
+	else if (opt.worker && opt.spp != SAMPLES_PER_PIXEL)
+		unused = "--spp";
+	else if (opt.worker && (opt.w != 1024 || opt.h != 768))
+		unused = "--size";
+	else if ((opt.worker || opt.connect) && samplingMethod != SAMPLING_METHOD)
+		unused = "--sampling";
+	else if (!opt.coordinator && opt.unitTimeout != DIST_UNIT_TIMEOUT)
+		unused = "--unit-timeout";
+	else if ((opt.coordinator || opt.connect) && opt.pin)
+		unused = "--pin";
+	else if (otherMode && opt.photons)
+		unused = "--photons";
+	else if (!opt.photons && opt.photonPasses != 1)
+		unused = "--photon-passes";
+	// El mapa de fotones estima la radiancia sin muestras por pixel ni --sampling
+	else if (opt.photons && opt.spp != SAMPLES_PER_PIXEL)
+		unused = "--spp";
+	else if (opt.photons && samplingMethod != SAMPLING_METHOD)
+		unused = "--sampling";
+	else if (!tiledRender && opt.baked)
+		unused = "--baked";
+	else if (!tiledRender && opt.framebuffer)
+		unused = "--framebuffer";
+	else if (!tiledRender && opt.outOfCore)
+		unused = "--out-of-core";
+	if (unused)
+		fprintf(stderr, "%s no se usa en este modo\n", unused);
+	return unused == NULL;
+}
+
+int main(int argc, char *argv[]) {
+	Options opt;
+	if (!parseOptions(argc, argv, opt)) {
+		fprintf(stderr, "uso: %s [--spp N] [--size WxH] [-o salida.ppm] [--sampling método] [--baked]\n"
+		                "          [--photons [--photon-passes N]]\n"
+		                "          [--framebuffer float|half] [--out-of-core archivo] [--pin]\n"
+		                "          [--coordinator <socket> [--unit-timeout S] | --worker <socket>]\n"
+		                "          [--daemon <socket>]\n"
+		                "          [--connect <socket> [--priority N] [--scene archivo] [--camera ox,oy,oz,dx,dy,dz]\n"
+		                "                              [--cancel ID | --status | --shutdown]]\n"
+		                "          [--converge [--reference ref.pfm] [--ref-spp N] [--interval S] [--time S]]\n"
+		                "          [--bench-baked]\n"
+		                "          [--sequence animación.txt [--scene archivo] [-o frame-%%04d.ppm]]\n"
+		                "métodos: uniform-sphere, uniform-hemisphere, cosine-hemisphere\n", argv[0]);
+		return 1;
+	}
+	if (!checkOptionModes(opt))
+		return 1;
+
+	// Fijar los hilos antes de cualquier modo que renderice: libgomp conserva
+	// el mismo equipo de hilos, y su afinidad, en las regiones paralelas
+	if (opt.pin)
+		pinThreads();
+
+	// Render distribuido: un coordinador y cualquier número de trabajadores
+	if (opt.coordinator)
+		return runCoordinator(opt.coordinator, opt.output, opt.w, opt.h, opt.spp, opt.unitTimeout);
+	if (opt.worker)
+		return runWorker(opt.worker);
+
+	// Servicio de render persistente y su cliente
+	if (opt.daemon)
+		return runDaemon(opt.daemon);
+	if (opt.connect) {
+		std::string command = opt.command;
+		if (command.empty()) {
+			char buf[256];
+			snprintf(buf, sizeof(buf), "RENDER spp=%d size=%dx%d priority=%d", opt.spp, opt.w, opt.h, opt.priority);
+			command = buf;
+			command += " output=" + quoteArgument(absolutePath(opt.output));
+			if (opt.scene) command += " scene=" + quoteArgument(absolutePath(opt.scene));
+			if (opt.camera) command += std::string(" camera=") + opt.camera;
+		}
+		return runClient(opt.connect, command);
+	}
+
+	// fija la posicion de la camara, la dirección en que mira y la resolución
+	View view = defaultView(opt.w, opt.h);
+	int w = view.w, h = view.h;
+
+	// Escena de archivo para los modos locales
+	Scene loaded;
+	if (opt.scene) {
+		std::string error;
+		if (opt.baked || opt.benchBaked || !loadScene(opt.scene, loaded, error)) {
+			fprintf(stderr, "%s\n", opt.baked || opt.benchBaked ? "--baked usa la escena compilada, no --scene" : error.c_str());
+			return 1;
+		}
+		scene = &loaded;
+	}
+
+	// Curva de convergencia contra una imagen de referencia
+	if (opt.converge)
+		return runConvergence(view, opt.scene, opt.reference, opt.referenceSpp, opt.interval, opt.budget);
+
+	// Secuencia animada
+	if (opt.sequence)
+		return runSequence(opt.sequence, view, opt.spp, strcmp(opt.output, "image.ppm") == 0 ? "frame-%04d.ppm" : opt.output);
+
+	// Escena compilada contra escena genérica
+	if (opt.benchBaked)
+		return runBakedBenchmark(view, opt.spp);
+
+	// shade() recorre la escena activa; bakedShade() la Cornell Box compilada
+	Color (*shadeFn)(const Ray &, int) = opt.baked ? bakedShade : shade;
+
+	if (opt.photons) {
+		Color *pixelColors = new Color[w * h];
+		renderPhotonMapping(pixelColors, view, opt.photonPasses);
+		fprintf(stderr,"\n");
+		bool written = writePPM(opt.output, pixelColors, w, h);
+		delete[] pixelColors;
+		return written ? 0 : 1;
+	}
+
+	// matriz para almacenar la imagen, por tiles
+	TiledFramebuffer framebuffer(w, h, opt.framebuffer && strcmp(opt.framebuffer, "half") == 0, opt.outOfCore);
+	if (!framebuffer.ok())
+		return 1;
+	int tilesDone = 0;
+	bool outOfMemory = false;
+
+	// usar openmp para paralelizar el ciclo: cada hilo computara un tile completo
+	#pragma omp parallel
+	{
+		std::vector<Color> tile(FB_TILE * FB_TILE);
+
+		#pragma omp for schedule(dynamic, 1)
+		for (int t = 0; t < framebuffer.tileCount(); t++) {
+			// Sin memoria ya no tiene caso seguir: los tiles restantes se saltan
+			bool stop;
+			#pragma omp atomic read
+			stop = outOfMemory;
+			if (stop) continue;
+
+			int x0, y0, x1, y1;
+			framebuffer.tileBounds(t, x0, y0, x1, y1);
+
+			// recorre todos los pixeles del tile
+			for (int row = y0; row < y1; row++) {
+				int y = h - row - 1; // renglón de la cámara: x,y son invertidos respecto a la imagen
+				for (int x = x0; x < x1; x++) {
+					Color pixelValue = Color(); // pixelValue en negro por ahora
+
+					// Monte Carlo sampling: usar múltiples muestras por pixel
+					for (int s = 0; s < opt.spp; s++) {
+						// computar el color del pixel para el punto que intersectó el rayo desde la camara
+						Color sampleColor = shadeFn( view.primaryRay(x, y), 0 );
+
+						// Acumular el color de la muestra
+						pixelValue = pixelValue + sampleColor;
+					}
+
+					// Promedio de todas las muestras
+					pixelValue = pixelValue * (1.0 / opt.spp);
+
+					// limitar los tres valores de color del pixel a [0,1]
+					tile[(row - y0) * FB_TILE + (x - x0)] = Color(clamp(pixelValue.x), clamp(pixelValue.y), clamp(pixelValue.z));
+				}
+			}
+
+			if (!framebuffer.storeTile(t, tile.data())) {
+				#pragma omp atomic write
+				outOfMemory = true;
+				continue;
+			}
+
+			int done;
+			#pragma omp atomic capture
+			done = ++tilesDone;
+			fprintf(stderr,"\r%5.2f%%",100.*done/framebuffer.tileCount());
+		}
+	}
+
+	fprintf(stderr,"\n");
+	if (outOfMemory) {
+		fprintf(stderr, "sin memoria para la imagen de %dx%d; usar --framebuffer half o --out-of-core\n", w, h);
+		return 1;
+	}
+
+	// PROYECTO 1
+	// Investigar formato ppm
+	return writePPM(opt.output, framebuffer, w, h) ? 0 : 1;
+}